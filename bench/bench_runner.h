@@ -0,0 +1,123 @@
+#pragma once
+// Minimal harness for slayout_bench: times a case until it has run for a
+// minimum wall time, counts heap allocations of one run through the operator
+// new replacement in slayout_bench.cpp, prints a table row and keeps the
+// numbers for the JSON report.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Incremented by the global operator new.
+extern std::atomic<uint64_t> allocationCount;
+extern std::atomic<uint64_t> allocatedBytes;
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;
+    double minSeconds = 0;
+    double medianSeconds = 0;
+    uint64_t bytes = 0;        // input bytes processed per run
+    uint64_t items = 0;        // tokens, statements, references... per run
+    uint64_t allocations = 0;  // per run
+    uint64_t allocatedBytes = 0;
+};
+
+struct Comparison {
+    std::string baseline;
+    std::string candidate;
+    double speedup = 0; // baseline median / candidate median
+};
+
+class Runner {
+public:
+    Runner(std::string filter, double minSeconds)
+        : filter(std::move(filter)), minSeconds(minSeconds) {}
+
+    bool enabled(const std::string& name) const {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    template <typename Fn>
+    void run(const std::string& name, uint64_t bytes, uint64_t items, Fn&& fn) {
+        if (!enabled(name)) return;
+
+        Result result;
+        result.name = name;
+        result.bytes = bytes;
+        result.items = items;
+
+        // The first run doubles as warm-up and as the allocation sample.
+        uint64_t allocationsBefore = allocationCount.load();
+        uint64_t bytesBefore = allocatedBytes.load();
+        fn();
+        result.allocations = allocationCount.load() - allocationsBefore;
+        result.allocatedBytes = allocatedBytes.load() - bytesBefore;
+
+        std::vector<double> samples;
+        double total = 0;
+        while ((total < minSeconds || samples.size() < 3) && samples.size() < 10000) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            samples.push_back(elapsed.count());
+            total += elapsed.count();
+        }
+        std::sort(samples.begin(), samples.end());
+        result.iterations = samples.size();
+        result.minSeconds = samples.front();
+        result.medianSeconds = samples[samples.size() / 2];
+
+        print(result);
+        results.push_back(result);
+    }
+
+    // Records how much faster `candidate` is than `baseline`; both must have run.
+    void compare(const std::string& baseline, const std::string& candidate) {
+        const Result* a = find(baseline);
+        const Result* b = find(candidate);
+        if (!a || !b) return;
+        Comparison comparison{baseline, candidate, a->medianSeconds / b->medianSeconds};
+        std::printf("  %-52s %.2fx faster than %s\n", candidate.c_str(), comparison.speedup, baseline.c_str());
+        comparisons.push_back(comparison);
+    }
+
+    const std::vector<Result>& all_results() const { return results; }
+    const std::vector<Comparison>& all_comparisons() const { return comparisons; }
+
+    static void print_header() {
+        std::printf("%-54s %10s %10s %12s %12s %10s\n", "benchmark", "median", "min", "MB/s", "items/s", "allocs");
+    }
+
+private:
+    std::string filter;
+    double minSeconds;
+    std::vector<Result> results;
+    std::vector<Comparison> comparisons;
+
+    const Result* find(const std::string& name) const {
+        for (const auto& result : results) {
+            if (result.name == name) return &result;
+        }
+        return nullptr;
+    }
+
+    static void print(const Result& result) {
+        char mbps[32] = "-";
+        char itemsps[32] = "-";
+        if (result.bytes) std::snprintf(mbps, sizeof(mbps), "%.1f", result.bytes / result.minSeconds / 1e6);
+        if (result.items) std::snprintf(itemsps, sizeof(itemsps), "%.3g", result.items / result.minSeconds);
+        std::printf("%-54s %8.3fms %8.3fms %12s %12s %10llu\n", result.name.c_str(),
+                    result.medianSeconds * 1e3, result.minSeconds * 1e3, mbps, itemsps,
+                    static_cast<unsigned long long>(result.allocations));
+        std::fflush(stdout);
+    }
+};
+
+} // namespace bench
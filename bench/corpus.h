@@ -0,0 +1,89 @@
+#pragma once
+// Synthetic inputs for slayout_bench: layouts with a chosen number of macros,
+// string variables, if blocks and read_* includes, and shaders of a chosen size
+// with a chosen number of %MACRO references. Output is deterministic for a
+// given spec, so numbers from different runs and machines are comparable.
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace corpus {
+
+struct LayoutSpec {
+    size_t macros = 1000;
+    size_t strings = 100;  // string variables, used to build backend values
+    size_t ifs = 100;      // boolean-guarded blocks, half of them taken
+    size_t includes = 0;   // macros whose GLSL value comes from read_glsl
+};
+
+struct Layout {
+    std::string source;
+    std::map<std::string, std::string> includes; // read_* path -> contents
+};
+
+struct ShaderSpec {
+    size_t bytes = 1 << 20;
+    size_t references = 4096; // %MACRO occurrences, spread evenly
+    size_t macros = 1000;     // references cycle through MACRO_0..MACRO_<macros-1>
+};
+
+inline std::string macro_name(size_t i) {
+    return "MACRO_" + std::to_string(i);
+}
+
+inline Layout make_layout(const LayoutSpec& spec) {
+    Layout layout;
+    std::string& out = layout.source;
+    size_t strings = spec.strings == 0 ? 1 : spec.strings;
+
+    for (size_t s = 0; s < strings; ++s) {
+        out += "string s" + std::to_string(s) + " = \"layout(std140, binding = " + std::to_string(s) + ")\";\n";
+    }
+    for (size_t b = 0; b < spec.ifs; ++b) {
+        out += "boolean b" + std::to_string(b) + " = " + (b % 2 == 0 ? "TRUE" : "FALSE") + ";\n";
+    }
+
+    for (size_t i = 0; i < spec.macros; ++i) {
+        std::string var = "m" + std::to_string(i);
+        std::string index = std::to_string(i);
+        out += "macrodef " + var + " = Macro(\"" + macro_name(i) + "\");\n";
+
+        if (i < spec.includes) {
+            std::string path = "include/block" + index + ".glsl";
+            out += var + ".read_glsl(\"" + path + "\");\n";
+            layout.includes[path] = "layout(std140, binding = " + index + ") uniform Block" + index + " { mat4 m; };\n";
+        } else {
+            out += var + ".set_glsl(s" + std::to_string(i % strings) + " + \" uniform Block" + index + ";\");\n";
+        }
+        out += var + ".set_hlsl(\"cbuffer Block" + index + " : register(b" + index + ");\");\n";
+
+        if (spec.ifs > 0 && i % ((spec.macros + spec.ifs - 1) / spec.ifs) == 0) {
+            out += "if (b" + std::to_string(i % spec.ifs) + ") {\n    " + var +
+                   ".set_default(\"uniform Block" + index + ";\");\n    " + var + ".lazy();\n}\n";
+        }
+    }
+
+    out += "SYSTEM->generate_all();\n";
+    return layout;
+}
+
+inline std::string make_shader(const ShaderSpec& spec) {
+    const std::string line = "    vec4 color = texture(sampler0, uv) * tint; float m = a % b;\n";
+    const size_t macros = spec.macros == 0 ? 1 : spec.macros;
+    const size_t spacing = spec.references == 0 ? spec.bytes : spec.bytes / spec.references;
+
+    std::string shader;
+    shader.reserve(spec.bytes + line.size() + 32);
+    size_t next = 0;
+    while (shader.size() < spec.bytes) {
+        size_t target = shader.size() + spacing;
+        while (shader.size() < target && shader.size() < spec.bytes) shader += line;
+        if (next < spec.references) {
+            shader += "%" + macro_name(next++ % macros) + "\n";
+        }
+    }
+    return shader;
+}
+
+} // namespace corpus
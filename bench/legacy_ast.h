@@ -0,0 +1,199 @@
+#pragma once
+// The shared_ptr + dynamic_pointer_cast AST the parser produced before the flat
+// Program, reduced to what the interpreter touches, and the name-keyed Macro it
+// filled in. slayout_bench converts a Program into this form to compare both
+// dispatch designs on the same input.
+#include "interpreter.h"
+#include <memory>
+#include <stdexcept>
+
+namespace legacy {
+
+struct Macro {
+    std::string macroName;
+    bool lazy = false;
+    std::map<std::string, std::string> backendValues; // keyed by lowercase backend name
+    std::string defaultValue;
+};
+
+inline std::map<std::string, Macro> convert(const std::map<std::string, ::Macro>& macros) {
+    std::map<std::string, Macro> result;
+    for (const auto& [name, macro] : macros) {
+        Macro& converted = result[name];
+        converted.macroName = macro.macroName;
+        converted.lazy = macro.lazy;
+        converted.defaultValue = macro.defaultValue;
+        for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+            if (macro.backendValues[b]) {
+                converted.backendValues[backend_name(static_cast<Backend>(b))] = *macro.backendValues[b];
+            }
+        }
+    }
+    return result;
+}
+
+struct Statement {
+    virtual ~Statement() = default;
+};
+
+struct MacroDefStatement : public Statement {
+    std::string varName;
+    std::string macroName;
+};
+
+struct SetStatement : public Statement {
+    std::string varName;
+    std::string backend;
+    std::vector<std::string> parts;
+    std::vector<bool> isLiteral;
+};
+
+struct SetDefaultStatement : public Statement {
+    std::string varName;
+    std::vector<std::string> parts;
+    std::vector<bool> isLiteral;
+};
+
+struct StringDeclaration : public Statement {
+    std::string name;
+    std::string expression;
+};
+
+struct LazyStatement : public Statement {
+    std::string varName;
+};
+
+struct BooleanDeclaration : public Statement {
+    std::string name;
+    bool value;
+};
+
+struct IfStatement : public Statement {
+    std::string conditionVar;
+    std::vector<std::shared_ptr<Statement>> body;
+};
+
+struct GenerateAllStatement : public Statement {};
+
+inline std::vector<std::shared_ptr<Statement>> convert(const ::Program& program, IndexRange range) {
+    std::vector<std::shared_ptr<Statement>> result;
+    for (uint32_t i = range.begin; i < range.end; ++i) {
+        const ::Statement& s = program.statements[i];
+        auto parts = [&](std::vector<std::string>& out, std::vector<bool>& literal) {
+            for (uint32_t p = s.range.begin; p < s.range.end; ++p) {
+                out.emplace_back(program.parts[p].text);
+                literal.push_back(program.parts[p].isLiteral);
+            }
+        };
+        switch (s.kind) {
+            case StatementKind::MacroDef: {
+                auto stmt = std::make_shared<MacroDefStatement>();
+                stmt->varName = std::string(s.name);
+                stmt->macroName = std::string(s.text);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::Set: {
+                auto stmt = std::make_shared<SetStatement>();
+                stmt->varName = std::string(s.name);
+                stmt->backend = std::string(s.text);
+                parts(stmt->parts, stmt->isLiteral);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::SetDefault: {
+                auto stmt = std::make_shared<SetDefaultStatement>();
+                stmt->varName = std::string(s.name);
+                parts(stmt->parts, stmt->isLiteral);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::String: {
+                auto stmt = std::make_shared<StringDeclaration>();
+                stmt->name = std::string(s.name);
+                stmt->expression = std::string(s.text);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::Lazy: {
+                auto stmt = std::make_shared<LazyStatement>();
+                stmt->varName = std::string(s.name);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::Boolean: {
+                auto stmt = std::make_shared<BooleanDeclaration>();
+                stmt->name = std::string(s.name);
+                stmt->value = s.flag;
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::If: {
+                auto stmt = std::make_shared<IfStatement>();
+                stmt->conditionVar = std::string(s.name);
+                stmt->body = convert(program, s.range);
+                result.push_back(stmt);
+                break;
+            }
+            case StatementKind::GenerateAll:
+                result.push_back(std::make_shared<GenerateAllStatement>());
+                break;
+            default:
+                throw std::runtime_error("legacy::convert: unsupported statement");
+        }
+    }
+    return result;
+}
+
+class Interpreter {
+public:
+    void interpret(const std::vector<std::shared_ptr<Statement>>& statements) {
+        for (const auto& stmt : statements) execute(stmt);
+    }
+
+    const std::map<std::string, Macro>& get_macros() const { return macros; }
+
+private:
+    std::map<std::string, Macro> macros;
+    std::map<std::string, bool> bools;
+    std::set<std::string> requiredBackends;
+    std::map<std::string, std::string> varToMacroName;
+    std::map<std::string, std::string> strings;
+
+    std::string join(const std::vector<std::string>& parts, const std::vector<bool>& isLiteral) {
+        std::string value;
+        for (size_t i = 0; i < parts.size(); ++i) {
+            value += isLiteral[i] ? parts[i] : strings.at(parts[i]);
+        }
+        return value;
+    }
+
+    void execute(const std::shared_ptr<Statement>& stmt) {
+        if (auto def = std::dynamic_pointer_cast<MacroDefStatement>(stmt)) {
+            varToMacroName[def->varName] = def->macroName;
+            macros[def->macroName] = Macro{def->macroName, false, {}, {}};
+        } else if (auto set = std::dynamic_pointer_cast<SetStatement>(stmt)) {
+            auto& macro = macros.at(varToMacroName.at(set->varName));
+            macro.backendValues[set->backend] = join(set->parts, set->isLiteral);
+        } else if (auto setd = std::dynamic_pointer_cast<SetDefaultStatement>(stmt)) {
+            auto& macro = macros.at(varToMacroName.at(setd->varName));
+            macro.defaultValue = join(setd->parts, setd->isLiteral);
+        } else if (auto lazy = std::dynamic_pointer_cast<LazyStatement>(stmt)) {
+            macros.at(varToMacroName.at(lazy->varName)).lazy = true;
+        } else if (auto b = std::dynamic_pointer_cast<BooleanDeclaration>(stmt)) {
+            bools[b->name] = b->value;
+        } else if (auto iff = std::dynamic_pointer_cast<IfStatement>(stmt)) {
+            if (bools.count(iff->conditionVar) && bools[iff->conditionVar]) {
+                for (const auto& child : iff->body) execute(child);
+            }
+        } else if (std::dynamic_pointer_cast<GenerateAllStatement>(stmt)) {
+            requiredBackends = {"glsl", "hlsl", "msl", "spirv"};
+        } else if (auto s = std::dynamic_pointer_cast<StringDeclaration>(stmt)) {
+            strings[s->name] = s->expression;
+        } else {
+            throw std::runtime_error("Unknown statement type in interpreter");
+        }
+    }
+};
+
+} // namespace legacy
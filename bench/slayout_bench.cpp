@@ -0,0 +1,543 @@
+#include "build_driver.h"
+#include "shader_processor.h"
+#include "slayout.h"
+#include "thread_pool.h"
+#include "legacy_ast.h"
+#include "tokenizer.h"
+#include "macro_scanner.h"
+#include "bench_runner.h"
+#include "corpus.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace fs = std::filesystem;
+
+// Every heap allocation in the process goes through here so each benchmark can
+// report how many allocations one run makes.
+namespace bench {
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocatedBytes{0};
+}
+
+void* operator new(std::size_t size) {
+    bench::allocationCount.fetch_add(1, std::memory_order_relaxed);
+    bench::allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// The std::regex substitution ShaderProcessor used before the hand-written scanner,
+// kept here as the baseline and as the reference for byte-identical output.
+static std::string expand_with_regex(const std::string& shaderCode,
+                                     const std::map<std::string, legacy::Macro>& macros,
+                                     std::string backendName) {
+    std::transform(backendName.begin(), backendName.end(), backendName.begin(), ::tolower);
+    std::regex macroRegex(R"(%([A-Za-z_][A-Za-z0-9_]*))");
+    std::smatch match;
+
+    std::string output;
+    std::string::const_iterator searchStart(shaderCode.cbegin());
+
+    while (std::regex_search(searchStart, shaderCode.cend(), match, macroRegex)) {
+        output += match.prefix().str();
+        std::string macroName = match[1].str();
+
+        if (macros.count(macroName)) {
+            const legacy::Macro& macro = macros.at(macroName);
+            if (macro.backendValues.count(backendName)) {
+                output += macro.backendValues.at(backendName);
+            } else if (!macro.defaultValue.empty()) {
+                output += macro.defaultValue;
+            } else if (macro.lazy) {
+                output += macro.macroName;
+            }
+        }
+
+        searchStart = match.suffix().first;
+    }
+
+    output += std::string(searchStart, shaderCode.cend());
+    return output;
+}
+
+// Swallows everything written to it, so streaming is measured without I/O.
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+    int overflow(int c) override { return c; }
+};
+
+[[noreturn]] static void fail(const std::string& message) {
+    std::cerr << "slayout_bench: " << message << "\n";
+    std::exit(1);
+}
+
+static std::string size_label(size_t bytes) {
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) return std::to_string(bytes >> 20) + "MiB";
+    if (bytes >= (1u << 10) && bytes % (1u << 10) == 0) return std::to_string(bytes >> 10) + "KiB";
+    return std::to_string(bytes) + "B";
+}
+
+static corpus::LayoutSpec layout_spec(size_t macros) {
+    corpus::LayoutSpec spec;
+    spec.macros = macros;
+    spec.strings = std::max<size_t>(1, macros / 10);
+    spec.ifs = std::max<size_t>(1, macros / 10);
+    spec.includes = macros / 10;
+    return spec;
+}
+
+static FileLoader loader_for(const corpus::Layout& layout) {
+    return [&layout](const std::string& path) { return layout.includes.at(path); };
+}
+
+// Tokenizer, parser, interpreter, macros.json export and layout loading for a
+// layout with `macros` macros.
+static void bench_layout_phases(bench::Runner& runner, size_t macros, const fs::path& workDir) {
+    const corpus::Layout layout = corpus::make_layout(layout_spec(macros));
+    const std::string suffix = "/macros=" + std::to_string(macros);
+    const uint64_t sourceBytes = layout.source.size();
+
+    Tokenizer tokenizer(layout.source);
+    const std::vector<Token> tokens = tokenizer.tokenize();
+    Parser parser(tokens);
+    const Program program = parser.parse();
+
+    Interpreter interpreter;
+    interpreter.set_file_loader(loader_for(layout));
+    interpreter.interpret(program);
+
+    runner.run("tokenize" + suffix, sourceBytes, tokens.size(), [&] {
+        Tokenizer t(layout.source);
+        t.tokenize();
+    });
+    runner.run("parse" + suffix, sourceBytes, program.statements.size(), [&] {
+        Parser p(tokens);
+        p.parse();
+    });
+    runner.run("interpret" + suffix, sourceBytes, program.statements.size(), [&] {
+        Interpreter i;
+        i.set_file_loader(loader_for(layout));
+        i.interpret(program);
+    });
+
+    const std::string metadataPath = (workDir / "macros.json").string();
+    runner.run("export_macro_metadata" + suffix, 0, interpreter.get_macros().size(), [&] {
+        interpreter.export_macro_metadata(metadataPath);
+    });
+
+    runner.run("macro_table_build" + suffix, 0, interpreter.get_macros().size(), [&] {
+        MacroTable::build(interpreter.get_macros(), interpreter.get_required_backends());
+    });
+
+    const std::string tablePath = (workDir / "layout.sltable").string();
+    Layout compiled = Layout::compile(layout.source, loader_for(layout));
+    compiled.write_table(tablePath);
+    runner.run("layout_compile" + suffix, sourceBytes, 0, [&] {
+        Layout::compile(layout.source, loader_for(layout));
+    });
+    runner.run("layout_open_table" + suffix, 0, 0, [&] {
+        Layout::open_table(tablePath);
+    });
+    runner.compare("layout_compile" + suffix, "layout_open_table" + suffix);
+}
+
+static bool same_macros(const std::map<std::string, legacy::Macro>& a, const std::map<std::string, legacy::Macro>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& x, const auto& y) {
+        return x.first == y.first && x.second.macroName == y.second.macroName && x.second.lazy == y.second.lazy &&
+               x.second.backendValues == y.second.backendValues && x.second.defaultValue == y.second.defaultValue;
+    });
+}
+
+// The dynamic_cast AST against the flat one, interpreting a generated layout of
+// at least `statements` statements. The legacy AST cannot load includes, so the
+// layout has none.
+static void bench_ast_designs(bench::Runner& runner, size_t statements) {
+    const std::string suffix = "/statements=" + std::to_string(statements);
+    std::string source;
+    Program program;
+    for (size_t macros = statements / 4; program.statements.size() < statements; macros += macros / 8) {
+        corpus::LayoutSpec spec = layout_spec(macros);
+        spec.includes = 0;
+        source = corpus::make_layout(spec).source;
+        Tokenizer tokenizer(source);
+        const std::vector<Token> tokens = tokenizer.tokenize();
+        Parser parser(tokens);
+        program = parser.parse();
+    }
+    const auto legacyStatements = legacy::convert(program, program.root);
+    {
+        Interpreter flat;
+        flat.interpret(program);
+        legacy::Interpreter old;
+        old.interpret(legacyStatements);
+        if (!same_macros(legacy::convert(flat.get_macros()), old.get_macros())) {
+            fail("flat and legacy AST disagree");
+        }
+    }
+    runner.run("interpret_legacy_ast" + suffix, source.size(), program.statements.size(), [&] {
+        legacy::Interpreter i;
+        i.interpret(legacyStatements);
+    });
+    runner.run("interpret_flat_ast" + suffix, source.size(), program.statements.size(), [&] {
+        Interpreter i;
+        i.interpret(program);
+    });
+    runner.compare("interpret_legacy_ast" + suffix, "interpret_flat_ast" + suffix);
+}
+
+// A whole batch build of `shaderCount` shaders at -j 1, 2, 4... up to the core
+// count, so scaling can be read off against threads=1. Console output is discarded.
+static void bench_build_scaling(bench::Runner& runner, size_t shaderCount, const fs::path& workDir) {
+    const corpus::Layout layout = corpus::make_layout(layout_spec(1000));
+    Layout compiled = Layout::compile(layout.source, loader_for(layout));
+
+    corpus::ShaderSpec spec;
+    spec.bytes = 256u << 10;
+    spec.references = spec.bytes / 256;
+    const std::string shader = corpus::make_shader(spec);
+    std::vector<ShaderJob> jobs;
+    for (size_t i = 0; i < shaderCount; ++i) {
+        fs::path dir = workDir / "batch" / std::to_string(i);
+        fs::create_directories(dir);
+        std::ofstream((dir / "input.shader").string(), std::ios::binary) << shader;
+        jobs.push_back(ShaderJob{(dir / "input.shader").string(), (dir / "out").string()});
+    }
+
+    const uint64_t bytes = shader.size() * shaderCount * compiled.backends().size();
+    const uint64_t items = jobs.size() * compiled.backends().size();
+    const std::string baseline = "build/threads=1,shaders=" + std::to_string(shaderCount);
+    NullBuffer null;
+    const unsigned cores = ThreadPool::default_thread_count();
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        const std::string name = "build/threads=" + std::to_string(threads) + ",shaders=" + std::to_string(shaderCount);
+        std::streambuf* out = std::cout.rdbuf(&null);
+        std::streambuf* err = std::cerr.rdbuf(&null);
+        runner.run(name, bytes, items, [&] {
+            // A fresh output tree each run, so every output is written.
+            for (const auto& job : jobs) fs::remove_all(job.outputDir);
+            BuildDriver(compiled.table(), threads).build(jobs);
+        });
+        std::cout.rdbuf(out);
+        std::cerr.rdbuf(err);
+        if (threads > 1) runner.compare(baseline, name);
+        if (threads == cores) break;
+    }
+    fs::remove_all(workDir / "batch");
+}
+
+// Substitution paths for a shader of `bytes` bytes with `references` %MACRO occurrences.
+static void bench_shader_phases(bench::Runner& runner, size_t bytes, size_t references,
+                                bool withRegex, const fs::path& workDir) {
+    const size_t macroCount = 1000;
+    const corpus::Layout layout = corpus::make_layout(layout_spec(macroCount));
+    Layout compiled = Layout::compile(layout.source, loader_for(layout));
+    Interpreter interpreter;
+    interpreter.set_file_loader(loader_for(layout));
+    {
+        Tokenizer tokenizer(layout.source);
+        auto tokens = tokenizer.tokenize();
+        Parser parser(tokens);
+        interpreter.interpret(parser.parse());
+    }
+    const auto& macros = interpreter.get_macros();
+    const MacroTable& table = compiled.table();
+
+    corpus::ShaderSpec spec;
+    spec.bytes = bytes;
+    spec.references = references;
+    spec.macros = macroCount;
+    const std::string shader = corpus::make_shader(spec);
+    const std::string suffix = "/" + size_label(bytes) + ",refs=" + std::to_string(references);
+
+    const std::string shaderPath = (workDir / "input.shader").string();
+    const std::string outputPath = (workDir / "shader.glsl").string();
+    {
+        std::ofstream out(shaderPath, std::ios::binary);
+        out << shader;
+    }
+
+    const ShaderTemplate scanned = ShaderTemplate::compile(shader);
+    const std::string expected = scanned.render(table, Backend::GLSL);
+    {
+        std::istringstream in(shader);
+        std::ostringstream out;
+        ShaderProcessor::stream_shader(in, out, table, Backend::GLSL, nullptr, 4096);
+        if (out.str() != expected) fail("streamed output differs from rendered output");
+        if (ShaderProcessor::expand_shader(shader, macros, Backend::GLSL) != expected) {
+            fail("map and table rendering differ");
+        }
+    }
+
+    runner.run("process_shader" + suffix, bytes, references, [&] {
+        ShaderProcessor::process_shader(shaderPath, outputPath, macros, Backend::GLSL);
+    });
+    runner.run("scan" + suffix, bytes, references, [&] {
+        ShaderTemplate::compile(shader);
+    });
+    runner.run("render_table" + suffix, bytes, references, [&] {
+        scanned.render(table, Backend::GLSL);
+    });
+    runner.run("render_macro_map" + suffix, bytes, references, [&] {
+        scanned.render(macros, Backend::GLSL);
+    });
+    runner.run("stream" + suffix, bytes, references, [&] {
+        std::istringstream in(shader);
+        NullBuffer sink;
+        std::ostream out(&sink);
+        ShaderProcessor::stream_shader(in, out, table, Backend::GLSL);
+    });
+
+    volatile size_t markers = 0;
+    runner.run("find_macro_marker" + suffix, bytes, 0, [&] {
+        const char* p = shader.data();
+        const char* end = p + shader.size();
+        size_t found = 0;
+        while ((p = find_macro_marker(p, end)) != end) { ++found; ++p; }
+        markers = found;
+    });
+
+    const Backend backends[] = {Backend::GLSL, Backend::HLSL, Backend::MSL, Backend::SPIRV};
+    std::vector<std::string> warnings; // most corpus macros have no MSL or SPIR-V value
+    runner.run("all_backends_scan_each" + suffix, bytes * 4, references * 4, [&] {
+        for (Backend backend : backends) {
+            warnings.clear();
+            ShaderTemplate::compile(shader).render(table, backend, &warnings);
+        }
+    });
+    runner.run("all_backends_scan_once" + suffix, bytes * 4, references * 4, [&] {
+        ShaderTemplate once = ShaderTemplate::compile(shader);
+        for (Backend backend : backends) {
+            warnings.clear();
+            once.render(table, backend, &warnings);
+        }
+    });
+    runner.compare("all_backends_scan_each" + suffix, "all_backends_scan_once" + suffix);
+
+    if (withRegex) {
+        const auto legacyMacros = legacy::convert(macros);
+        if (expand_with_regex(shader, legacyMacros, "glsl") != expected) {
+            fail("scanner output differs from regex output");
+        }
+        runner.run("regex_substitution" + suffix, bytes, references, [&] {
+            expand_with_regex(shader, legacyMacros, "glsl");
+        });
+        runner.run("scanner_substitution" + suffix, bytes, references, [&] {
+            ShaderProcessor::expand_shader(shader, macros, Backend::GLSL);
+        });
+        runner.compare("regex_substitution" + suffix, "scanner_substitution" + suffix);
+    }
+}
+
+// Cost of resolving one %MACRO reference: the per-occurrence lowercase copy and
+// four map lookups the processor used to do, against Macro::resolve on the dense
+// per-backend array and a probe of the precomputed macro table.
+static void bench_lookup(bench::Runner& runner, size_t references) {
+    const corpus::Layout layout = corpus::make_layout(layout_spec(1024));
+    Layout compiled = Layout::compile(layout.source, loader_for(layout));
+    Interpreter interpreter;
+    interpreter.set_file_loader(loader_for(layout));
+    {
+        Tokenizer tokenizer(layout.source);
+        auto tokens = tokenizer.tokenize();
+        Parser parser(tokens);
+        interpreter.interpret(parser.parse());
+    }
+    const auto& macros = interpreter.get_macros();
+    const auto legacyMacros = legacy::convert(macros);
+    const MacroTable& table = compiled.table();
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < references; ++i) names.push_back(corpus::macro_name((i * 7919) % 1024));
+
+    volatile size_t sink = 0;
+    runner.run("lookup_lowercase_map", 0, references, [&] {
+        size_t total = 0;
+        for (const auto& name : names) {
+            std::string backend = "HLSL";
+            std::transform(backend.begin(), backend.end(), backend.begin(), ::tolower);
+            if (legacyMacros.count(name)) {
+                const legacy::Macro& macro = legacyMacros.at(name);
+                if (macro.backendValues.count(backend)) total += macro.backendValues.at(backend).size();
+                else total += macro.defaultValue.size();
+            }
+        }
+        sink = total;
+    });
+    runner.run("lookup_dense_resolve", 0, references, [&] {
+        size_t total = 0;
+        for (const auto& name : names) {
+            auto it = macros.find(name);
+            if (it == macros.end()) continue;
+            std::string_view value;
+            if (it->second.resolve(Backend::HLSL, value)) total += value.size();
+        }
+        sink = total;
+    });
+    runner.run("lookup_macro_table", 0, references, [&] {
+        size_t total = 0;
+        std::string_view value;
+        for (const auto& name : names) {
+            uint32_t index = table.find(name);
+            if (index != MacroTable::NOT_FOUND && table.value(index, Backend::HLSL, value)) total += value.size();
+        }
+        sink = total;
+    });
+    runner.compare("lookup_lowercase_map", "lookup_dense_resolve");
+    runner.compare("lookup_lowercase_map", "lookup_macro_table");
+}
+
+// Writes a corpus to disk for profiling slayoutc itself, e.g. as a PGO training set:
+// layout.slayout, its read_* includes, shaders/*.shader and a shaders.txt manifest.
+static void generate_corpus(const fs::path& dir) {
+    corpus::LayoutSpec layoutSpec = layout_spec(2000);
+    corpus::Layout layout = corpus::make_layout(layoutSpec);
+
+    fs::create_directories(dir / "include");
+    fs::create_directories(dir / "shaders");
+    std::ofstream(dir / "layout.slayout") << layout.source;
+    for (const auto& [path, contents] : layout.includes) {
+        std::ofstream(dir / path) << contents;
+    }
+
+    std::ofstream manifest(dir / "shaders.txt");
+    for (size_t i = 0; i < 16; ++i) {
+        corpus::ShaderSpec spec;
+        spec.bytes = 256u << 10;
+        spec.references = spec.bytes / (64 + 192 * (i % 4));
+        spec.macros = layoutSpec.macros;
+        std::string name = "shaders/shader" + std::to_string(i) + ".shader";
+        std::ofstream(dir / name) << corpus::make_shader(spec);
+        manifest << name << "\n";
+    }
+    std::cout << "Generated corpus in " << dir.string() << " (run slayoutc from there)\n";
+}
+
+static void write_json(const std::string& path, const bench::Runner& runner) {
+    nlohmann::json report;
+    report["context"]["macro_scanner_isa"] = macro_scanner_isa();
+#if defined(__VERSION__)
+    report["context"]["compiler"] = __VERSION__;
+#endif
+#if defined(NDEBUG)
+    report["context"]["assertions"] = false;
+#else
+    report["context"]["assertions"] = true;
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+    report["context"]["address_sanitizer"] = true;
+#else
+    report["context"]["address_sanitizer"] = false;
+#endif
+
+    report["benchmarks"] = nlohmann::json::array();
+    for (const auto& result : runner.all_results()) {
+        nlohmann::json entry;
+        entry["name"] = result.name;
+        entry["iterations"] = result.iterations;
+        entry["min_seconds"] = result.minSeconds;
+        entry["median_seconds"] = result.medianSeconds;
+        entry["bytes"] = result.bytes;
+        entry["items"] = result.items;
+        if (result.bytes) entry["bytes_per_second"] = result.bytes / result.minSeconds;
+        if (result.items) entry["items_per_second"] = result.items / result.minSeconds;
+        entry["allocations"] = result.allocations;
+        entry["allocated_bytes"] = result.allocatedBytes;
+        report["benchmarks"].push_back(entry);
+    }
+    report["comparisons"] = nlohmann::json::array();
+    for (const auto& comparison : runner.all_comparisons()) {
+        report["comparisons"].push_back({{"baseline", comparison.baseline},
+                                         {"candidate", comparison.candidate},
+                                         {"speedup", comparison.speedup}});
+    }
+
+    std::ofstream out(path);
+    if (!out) fail("cannot write " + path);
+    out << report.dump(4) << "\n";
+}
+
+static const char* usage() {
+    return "Usage: slayout_bench [--quick] [--filter <text>] [--min-time <seconds>] [--json <file>]\n"
+           "       slayout_bench --generate <dir>\n"
+           "\n"
+           "  --quick            Smaller inputs, for a fast smoke run\n"
+           "  --filter <text>    Only run benchmarks whose name contains <text>\n"
+           "  --min-time <s>     Minimum time spent per benchmark (default 0.5)\n"
+           "  --json <file>      Also write the results as JSON\n"
+           "  --generate <dir>   Write a synthetic layout and shader corpus and exit\n";
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    std::string filter;
+    std::string jsonPath;
+    double minTime = 0.5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            minTime = std::atof(argv[++i]);
+        } else if (arg == "--generate" && hasValue) {
+            generate_corpus(argv[++i]);
+            return 0;
+        } else {
+            std::cerr << usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    fs::path workDir = fs::temp_directory_path() / "slayout_bench";
+    fs::create_directories(workDir);
+
+    std::cout << "macro scanner isa: " << macro_scanner_isa() << "\n";
+    bench::Runner runner(filter, quick ? 0.05 : minTime);
+    bench::Runner::print_header();
+
+    const std::vector<size_t> layoutSizes = quick ? std::vector<size_t>{100, 1000}
+                                                  : std::vector<size_t>{100, 1000, 10000};
+    for (size_t macros : layoutSizes) {
+        bench_layout_phases(runner, macros, workDir);
+    }
+    bench_ast_designs(runner, quick ? 5000 : 50000);
+
+    const std::vector<size_t> shaderSizes = quick ? std::vector<size_t>{64u << 10, 1u << 20}
+                                                  : std::vector<size_t>{64u << 10, 1u << 20, 16u << 20};
+    for (size_t bytes : shaderSizes) {
+        // Dense (a reference every 256 bytes) and sparse (every 16 KiB) shaders.
+        bench_shader_phases(runner, bytes, bytes / 256, bytes <= (1u << 20), workDir);
+        bench_shader_phases(runner, bytes, std::max<size_t>(1, bytes / 16384), bytes <= (1u << 20), workDir);
+    }
+
+    bench_lookup(runner, quick ? 100000 : 1000000);
+
+    bench_build_scaling(runner, quick ? 16 : 64, workDir);
+
+    fs::remove_all(workDir);
+    if (!jsonPath.empty()) {
+        write_json(jsonPath, runner);
+    }
+    return 0;
+}
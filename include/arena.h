@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Read-only view of an array copied into an Arena with Arena::copy().
+template <typename T>
+class ArenaArray {
+public:
+    ArenaArray() = default;
+    ArenaArray(const T* data, size_t size) : items(data), count(size) {}
+
+    const T& operator[](size_t index) const { return items[index]; }
+    const T* data() const { return items; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+private:
+    const T* items = nullptr;
+    size_t count = 0;
+};
+
+// Bump allocator. Memory is carved out of large blocks and released all at once
+// when the arena is destroyed; nothing is freed individually. Blocks never move,
+// so pointers and string_views into the arena stay valid when the arena itself
+// is moved.
+class Arena {
+public:
+    Arena() = default;
+    explicit Arena(size_t blockSize);
+
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Copies text into the arena and returns a view of the copy.
+    std::string_view copy(std::string_view text);
+
+    // Copies values into the arena in one block and returns a view of the copy.
+    template <typename T>
+    ArenaArray<T> copy(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "arena arrays are never destroyed");
+        if (values.empty()) return {};
+        T* data = static_cast<T*>(allocate(values.size() * sizeof(T), alignof(T)));
+        std::memcpy(static_cast<void*>(data), values.data(), values.size() * sizeof(T));
+        return ArenaArray<T>(data, values.size());
+    }
+
+    size_t bytes_allocated() const;
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t blockSize = 64 * 1024;
+    size_t used = 0;
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "output_file.h"
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Reads and writes whole files off the calling thread, so a batch can read the
+// next shaders and write finished outputs while the current shader is being
+// expanded, on a few blocking I/O threads.
+//
+// At most `queueDepth` requests are in flight; read() and write() block until a
+// slot frees up, so memory stays flat however many files a batch touches.
+class AsyncIO {
+public:
+    static constexpr unsigned DEFAULT_QUEUE_DEPTH = 32;
+
+    explicit AsyncIO(unsigned queueDepth = DEFAULT_QUEUE_DEPTH);
+    // Waits for every request still in flight.
+    ~AsyncIO();
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    // The future throws std::runtime_error if the file cannot be read or written.
+    // Writes follow write_if_changed(): identical files are left alone, anything
+    // else is written to a temporary file and renamed into place.
+    std::future<std::string> read(std::string path);
+    std::future<WriteStatus> write(std::string path, std::string contents);
+
+    struct Request;
+    class Engine;
+
+private:
+    std::unique_ptr<Engine> engine;
+    unsigned queueDepth;
+    unsigned inFlight = 0;
+    std::mutex mutex;
+    std::condition_variable slotFree;
+
+    void submit(std::unique_ptr<Request> request);
+    void finish(std::unique_ptr<Request> request, std::exception_ptr error);
+};
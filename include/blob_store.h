@@ -0,0 +1,31 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Directory of content-addressed files. Every distinct byte string is written
+// once, as <directory>/<xxh64 hex><extension>; storing the same bytes again
+// returns the existing name once that blob is on disk. Safe to use from several
+// threads.
+class BlobStore {
+public:
+    explicit BlobStore(std::string directory);
+
+    // Returns the blob's file name, relative to the store directory. Throws
+    // std::runtime_error if the blob cannot be written, or if different bytes
+    // already stored under the same name collide with `contents`.
+    std::string put(std::string_view contents, std::string_view extension);
+
+    const std::string& directory() const;
+    // Distinct blobs stored through this instance.
+    size_t size() const;
+
+private:
+    std::string root;
+    mutable std::mutex mutex;
+    std::condition_variable blobWritten;
+    std::map<std::string, bool> names; // false while the first put() is still writing it
+};
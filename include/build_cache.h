@@ -0,0 +1,84 @@
+#pragma once
+#include "macro_table.h"
+#include "shader_template.h"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// On-disk record of which inputs produced each generated file.
+// An output is fresh when it still exists and was last written from inputs
+// with the same key, so it can be skipped without rendering or writing.
+//
+// The cache also keeps every shader compiled into a ShaderTemplate, keyed by the
+// shader's content hash, and remembers each shader's hash by size and modification
+// time. After a layout edit, outputs are re-rendered from the stored templates
+// without reading or rescanning shader sources.
+//
+// A shader's outputs depend only on the macros it references, so the cache also
+// keeps a usage index of the macros (and their offsets) in every shader, and the
+// per-backend value of every macro as of the last save. Editing one macro then
+// only regenerates the outputs whose shader references it.
+class BuildCache {
+public:
+    // Loads <directory>/outputs.idx and shaders.idx if present. The directory is created on save().
+    explicit BuildCache(std::string directory);
+
+    bool is_fresh(const std::string& outputPath, uint64_t key) const;
+    void record(const std::string& outputPath, uint64_t key);
+
+    // Hash of a shader recorded earlier, as long as its size and modification time
+    // are unchanged. Returns false when the shader has to be read and hashed.
+    bool shader_hash(const std::string& shaderPath, uint64_t& hash) const;
+    void record_shader(const std::string& shaderPath, uint64_t hash);
+
+    // Compiled templates live in <directory>/templates/<hash>.slt.
+    bool load_template(uint64_t shaderHash, ShaderTemplate& shader) const;
+    void store_template(uint64_t shaderHash, const ShaderTemplate& shader) const;
+
+    // Usage index entry for a shader, by content hash.
+    bool usage(uint64_t shaderHash, std::vector<MacroUsage>& usage) const;
+    void record_usage(uint64_t shaderHash, std::vector<MacroUsage> usage);
+
+    // Stores the value hashes of `table` for the next save() and returns the macros
+    // whose value for some backend differs from the table saved last time, including
+    // added and removed ones. Empty when there is no previous table.
+    std::vector<std::string> record_macros(const MacroTable& table, const std::vector<uint64_t>& valueHashes);
+
+    // Writes every index and deletes templates no recorded shader refers to.
+    void save() const;
+
+    // Key of everything the layout side contributes: the resolved macro table, which
+    // already covers every read_* file.
+    static uint64_t layout_key(const MacroTable& table);
+    // Hash of each macro's resolved value, at index * BACKEND_COUNT + backend.
+    static std::vector<uint64_t> value_hashes(const MacroTable& table);
+    // Key of the values the macros in `usage` resolve to for one backend.
+    static uint64_t usage_key(const std::vector<MacroUsage>& usage, const MacroTable& table,
+                              const std::vector<uint64_t>& valueHashes, Backend backend);
+    static uint64_t output_key(uint64_t shaderHash, Backend backend, uint64_t usageKey);
+    // macros.json only depends on the layout.
+    static uint64_t metadata_key(uint64_t layoutKey);
+
+private:
+    struct ShaderEntry {
+        uint64_t hash;
+        uint64_t size;
+        int64_t mtime; // file_time_type ticks; 0 when too recent to trust
+    };
+
+    std::string directory;
+    mutable std::mutex mutex;
+    std::map<std::string, uint64_t> entries;
+    std::map<std::string, ShaderEntry> shaders;
+    std::map<uint64_t, std::vector<MacroUsage>> usages;
+    std::map<std::string, std::vector<uint64_t>> macroValues; // name -> value hash per backend
+
+    std::string index_path() const;
+    std::string shader_index_path() const;
+    std::string usage_index_path() const;
+    std::string macro_index_path() const;
+    std::string template_path(uint64_t shaderHash) const;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include "blob_store.h"
+#include "build_cache.h"
+#include "build_stats.h"
+#include "cli_options.h"
+#include "macro_table.h"
+#include "output_file.h"
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <string>
+#include <vector>
+
+// Expands a batch of shaders against one layout's macro table.
+// Every (shader, backend) pair is an independent task; with more than one
+// thread they run on a work-stealing pool. Shader reads and output writes go
+// through AsyncIO, so they overlap with expansion even on one thread. Warnings and progress messages are
+// buffered per task and printed in job order, so output does not depend on
+// scheduling.
+class BuildDriver {
+public:
+    explicit BuildDriver(const MacroTable& table, unsigned threadCount = 1);
+
+    // Skips outputs whose shader and referenced macro values are unchanged since they
+    // were last written, and records every output written from now on.
+    void enable_cache(BuildCache& cache, uint64_t layoutKey);
+
+    // Records a span for every shader load and every (shader, backend) render,
+    // plus bytes read and written and resolved substitutions per backend.
+    void enable_stats(BuildStats& stats);
+
+    // Stores each distinct output once in `store`, named by its contents, and writes
+    // <store>/outputs.json mapping every shader and backend to its blob. With `link`
+    // the usual output paths are hard links to the blobs; without it only the store
+    // is written.
+    void enable_dedup(BlobStore& store, bool link);
+
+    // Writes <output_dir>/hashes.json with the XXH64 hash and size of every output and
+    // the macros expanded into each one, so consumers need not hash the files again.
+    void enable_hashes();
+
+    void build(const std::vector<ShaderJob>& jobs) const;
+
+    // Every file build() writes for a job: shader.<backend> for each backend, then
+    // macros.json and, with enable_hashes(), hashes.json.
+    std::vector<std::string> output_paths(const ShaderJob& job) const;
+
+private:
+    struct TaskResult {
+        std::string outputPath;
+        std::vector<std::string> warnings;
+        std::exception_ptr error;
+        bool upToDate = false;
+        uint64_t key = 0;           // cache key of the output
+        std::future<WriteStatus> written; // pending AsyncIO write
+        std::string blob;           // file name in the BlobStore, when deduplicating
+        uint64_t contentHash = 0;   // hash64 of the rendered output, with enable_hashes()
+        size_t contentSize = 0;
+    };
+
+    const MacroTable& table;
+    std::vector<Backend> backends;
+    unsigned threadCount;
+    BuildCache* cache = nullptr;
+    uint64_t layoutKey = 0;
+    std::vector<uint64_t> valueHashes; // BuildCache::value_hashes(table)
+    size_t changedMacros = 0;
+    BuildStats* stats = nullptr;
+    BlobStore* blobs = nullptr;
+    bool linkOutputs = false;
+    bool writeHashes = false;
+
+    // Puts an output in the blob store and, when linking, links its output path to it.
+    std::string store_output(const std::string& path, const std::string& contents) const;
+    void write_hashes(const ShaderJob& job, const TaskResult* results, const std::vector<MacroUsage>& usage,
+                      uint64_t metadataHash, size_t metadataSize) const;
+    void write_dedup_manifest(const std::vector<ShaderJob>& jobs, const std::vector<TaskResult>& results,
+                              const std::vector<std::string>& metadataBlobs) const;
+};
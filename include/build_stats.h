@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Wall time per phase and named counters for one slayoutc run. --stats prints a
+// summary, --trace writes the spans in Chrome trace-event format for
+// chrome://tracing or Perfetto. Safe to record into from several threads.
+class BuildStats {
+public:
+    BuildStats();
+
+    // Times the enclosing scope. A null `stats` makes the span a no-op, so call
+    // sites do not need to check whether statistics were asked for.
+    class Span {
+    public:
+        Span(BuildStats* stats, std::string name, const char* category = "phase", std::string detail = {});
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        BuildStats* stats;
+        std::string name;
+        const char* category;
+        std::string detail;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void add(const std::string& counter, uint64_t value = 1);
+
+    // Spans summed by category and name in order of first use, then every counter.
+    void print(std::ostream& out) const;
+    void write_trace(const std::string& path) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event {
+        std::string name;
+        const char* category;
+        std::string detail;
+        double startUs;
+        double durationUs;
+        unsigned thread;
+    };
+
+    mutable std::mutex mutex;
+    Clock::time_point origin;
+    std::vector<Event> events;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::thread::id, unsigned> threads; // small ids for the trace, 0 is the first thread seen
+
+    void record(std::string name, const char* category, std::string detail,
+                Clock::time_point start, Clock::time_point end);
+};
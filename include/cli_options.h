@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// One shader to expand and the directory its shader.<backend> files go to.
+// When streaming, "-" stands for stdin as the shader and stdout as the output.
+struct ShaderJob {
+    std::string shaderPath;
+    std::string outputDir;
+};
+
+struct CliOptions {
+    std::string layoutPath;
+    std::vector<ShaderJob> jobs;
+    unsigned threadCount = 1;
+    std::string cacheDir;
+    std::string depfilePath;   // --depfile: one depfile covering every job
+    bool depfilePerOutput = false; // -MD: <output_dir>/shader.d for each job
+    bool watch = false;
+    std::string tablePath;     // --emit-table: binary macro table to write
+    std::vector<std::string> permuteAxes; // --permute: booleans to sweep
+    bool stream = false;       // --stream, or "-" as shader or output: expand chunk by chunk
+    std::string backendName;   // --backend: the one backend to stream
+    bool stats = false;        // --stats: print phase times and counters to stderr
+    std::string tracePath;     // --trace: Chrome trace-event file to write
+    std::string dedupDir;      // --dedup: content-addressed store for every output
+    bool link = false;         // --link: hard-link output paths to their blobs in the store
+    bool hashes = false;       // --hashes: <output_dir>/hashes.json with each output's hash and size
+    std::string cppPath;       // --emit-cpp: <path>.h and <path>_data.h embedding every output
+    bool lazyReads = false;    // --lazy-reads: skip read_* files no generated backend uses
+};
+
+// Parses the command line. Throws std::runtime_error on malformed arguments.
+CliOptions parse_cli_options(int argc, char** argv);
+
+// Reads a manifest with one "<input.shader> [<output_dir>]" entry per line.
+// Blank lines and lines starting with '#' are ignored. Entries without an output
+// directory go to <defaultOutputDir>/<shader name>.
+std::vector<ShaderJob> read_manifest(const std::string& manifestPath, const std::string& defaultOutputDir);
+
+const char* cli_usage();
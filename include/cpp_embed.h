@@ -0,0 +1,21 @@
+#pragma once
+#include "parser.h"
+#include <string>
+#include <vector>
+
+// One expanded shader to compile into a program.
+struct EmbeddedShader {
+    std::string name; // looked up by this, usually the shader file's stem
+    Backend backend;
+    std::string text;
+};
+
+// Writes <basePath>.h and <basePath>_data.h. The data header defines every
+// shader's text as an inline constexpr std::string_view (over a char array when
+// the text is too long for one literal) and a constexpr table sorted by name and
+// backend. The main header defines a Backend enum matching slayoutc's, includes
+// the data and defines a constexpr find_shader(), so shaders can be looked up at
+// compile time and nothing is read or parsed at startup. Everything lives in a
+// namespace named after the file.
+// Throws std::runtime_error if two shaders share a name and backend.
+void write_cpp_embedding(const std::string& basePath, std::vector<EmbeddedShader> shaders);
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// One "targets: dependencies" rule of a Make/Ninja depfile.
+struct DepfileRule {
+    std::vector<std::string> targets;
+    std::vector<std::string> dependencies;
+};
+
+// Writes rules in the GCC -MD format understood by Make and Ninja.
+// Paths are escaped; duplicate dependencies within a rule are dropped.
+void write_depfile(const std::string& path, const std::vector<DepfileRule>& rules);
@@ -0,0 +1,45 @@
+#pragma once
+#include "mapped_file.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A file pulled in by read_*, recorded so callers can track layout dependencies.
+struct LoadedFile {
+    std::string path;
+    uint64_t contentHash;
+    uint64_t size;
+};
+
+// Resolves a read_* path to file contents.
+using FileLoader = std::function<std::string(const std::string& path)>;
+
+// Per-run cache of files loaded through read_*. Each path is loaded at most
+// once, memory-mapped when it is large and no FileLoader serves it, and stays
+// loaded for the lifetime of the store. Safe to share between interpreters and threads.
+class FileStore {
+public:
+    explicit FileStore(FileLoader loader = nullptr);
+
+    // Throws std::runtime_error if the file cannot be read.
+    std::string_view load(const std::string& path);
+
+    // Every distinct file loaded so far, in load order.
+    std::vector<LoadedFile> loaded_files() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const MappedFile> mapped;
+        std::string loaded; // contents returned by the FileLoader
+    };
+
+    FileLoader loader;
+    mutable std::mutex mutex;
+    std::map<std::string, Entry> files;
+    std::vector<LoadedFile> loadOrder;
+};
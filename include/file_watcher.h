@@ -0,0 +1,35 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports changes to a set of files. Parent directories are watched rather than
+// the files themselves, so editors that save by writing a temporary file and
+// renaming it over the original are still seen. Backed by inotify; only
+// available on Linux.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Replaces the set of watched files. Files whose directory does not exist are
+    // not watched until they are passed again.
+    void set_files(const std::vector<std::string>& paths);
+
+    // Blocks until at least one watched file changes, then keeps collecting
+    // events until none arrive for `settleMs`. Returns the changed paths in the
+    // form they were passed to set_files.
+    std::vector<std::string> wait(int settleMs = 50);
+
+    static bool supported();
+
+private:
+    int fd = -1;
+    std::map<int, std::string> directories;           // watch descriptor -> directory
+    std::map<std::string, std::string> files;         // normalized path -> path as given
+
+    bool read_events(int timeoutMs, std::vector<std::string>& changed);
+};
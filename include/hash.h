@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// XXH64 of a byte range. Stable across platforms, so hashes can be persisted.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
+
+inline uint64_t hash64(std::string_view text, uint64_t seed = 0) {
+    return hash64(text.data(), text.size(), seed);
+}
+
+// Mixes `value` into `seed`; order dependent.
+uint64_t hash_combine(uint64_t seed, uint64_t value);
+
+// 16 lowercase hex digits.
+std::string hash_to_hex(uint64_t hash);
+bool hash_from_hex(std::string_view hex, uint64_t& hash);
@@ -1,35 +1,95 @@
 #pragma once
+#include "arena.h"
+#include "build_stats.h"
+#include "file_store.h"
 #include "parser.h"
+#include <array>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <optional>
 #include <set>
 #include <string>
+#include <utility>
 
+// Values are views into storage shared by an interpreter and its copies; read_*
+// values point straight at the loaded file. They stay valid while any of those
+// interpreters lives.
 struct Macro {
     std::string macroName;
     bool lazy = false;
-    std::map<std::string, std::string> backendValues;
-    std::string defaultValue;
+    std::array<std::optional<std::string_view>, BACKEND_COUNT> backendValues; // indexed by Backend
+    std::string_view defaultValue;
+    // read_* paths never loaded because no generated backend can use them, by
+    // Backend value with BACKEND_COUNT for the default. Their values stay empty.
+    std::map<size_t, std::string> unreadFiles;
+
+    // Text that replaces %NAME for `backend`: the backend's own value, else the
+    // default, else the name itself when lazy. False when nothing applies.
+    bool resolve(Backend backend, std::string_view& text) const;
 };
 
 class Interpreter {
 public:
-    void interpret(const std::vector<std::shared_ptr<Statement>>& statements);
+    // Replaces the default disk reads done for read_* statements, e.g. to serve
+    // includes from memory when embedding the compiler.
+    void set_file_loader(FileLoader loader);
+
+    // Times the read_* loads as their own span.
+    void set_stats(BuildStats* stats);
+
+    // read_* files are only loaded once interpretation finishes, and only for
+    // values no later statement replaced. Each path is loaded once per store;
+    // copies of an interpreter share it.
+    void interpret(const Program& program);
+    // Runs only part of program.root, continuing from whatever state earlier calls
+    // left behind. A copy of the interpreter snapshots that state. read_* files
+    // stay pending until load_reads().
+    void interpret(const Program& program, IndexRange statements);
+    void load_reads();
+
+    // Makes every `boolean name = ...;` declaration assign `value` instead.
+    void override_boolean(std::string name, bool value);
+
+    // Skips print statements, e.g. for the second and later runs of the same statements.
+    void set_quiet(bool quiet);
+
+    // Also leaves read_* files unloaded when no generated backend can use their
+    // value. Their paths are kept in Macro::unreadFiles instead of the contents.
+    void set_lazy_reads(bool lazy);
 
     const std::map<std::string, Macro>& get_macros() const;
-    const std::set<std::string>& get_required_backends() const;
+    const std::set<Backend>& get_required_backends() const;
+    std::vector<LoadedFile> get_loaded_files() const;
     void export_macro_metadata(const std::string& outputPath) const;
 
 private:
     std::map<std::string, Macro> macros;
-    std::map<std::string, bool> bools;
-    std::set<std::string> requiredBackends;
-    std::map<std::string, std::string> varToMacroName;
-    std::map<std::string, std::string> strings;
+    std::map<std::string, bool, std::less<>> bools;
+    std::map<std::string, bool, std::less<>> boolOverrides;
+    std::set<Backend> requiredBackends;
+    std::map<std::string, std::string, std::less<>> varToMacroName;
+    std::map<std::string, std::string, std::less<>> strings;
+    std::shared_ptr<FileStore> files = std::make_shared<FileStore>();
+    std::shared_ptr<Arena> values = std::make_shared<Arena>(); // set_* text the macros point into
 
-    void execute(const std::shared_ptr<Statement>& stmt);
-    void execute_block(const std::vector<std::shared_ptr<Statement>>& body);
+    // A read_* value waiting to be loaded. slot is a Backend, or BACKEND_COUNT for the default.
+    struct PendingRead {
+        uint64_t order;
+        std::string path;
+    };
+    std::map<std::pair<std::string, size_t>, PendingRead> pendingReads;
+    uint64_t readCount = 0;
+    BuildStats* stats = nullptr;
+    bool quiet = false;
+    bool lazyReads = false;
 
-    std::string load_file(const std::string& path);
+    void execute(const Program& program, const Statement& stmt);
+    void execute_block(const Program& program, IndexRange body);
 
-    std::string to_lower(const std::string& s) const;
+    Macro& macro_for(std::string_view varName);
+    void assign_value(const Program& program, const Statement& stmt, Macro& macro, size_t slot, const char* readName);
+    std::string evaluate_parts(const Program& program, const Statement& stmt) const;
+    // Whether a generated backend can end up with the value in `slot`.
+    bool slot_used(const Macro& macro, size_t slot) const;
 };
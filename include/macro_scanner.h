@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// Returns a pointer to the first '%' in [begin, end), or end if there is none.
+// Uses AVX2 or SSE2 when the target supports it and a scalar loop otherwise.
+const char* find_macro_marker(const char* begin, const char* end);
+
+// Name of the vector path find_macro_marker was compiled with ("avx2", "sse2" or "scalar").
+const char* macro_scanner_isa();
+
+inline bool is_macro_name_start(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
+}
+
+inline bool is_macro_name_char(char c) {
+    return is_macro_name_start(c) || (c >= '0' && c <= '9');
+}
+
+// Walks `text` and reports it as alternating literal spans and %MACRO references,
+// matching the `%([A-Za-z_][A-Za-z0-9_]*)` pattern the shader processor used to search with.
+// onLiteral(std::string_view) receives the text between references (possibly empty),
+// onMacro(std::string_view) receives the macro name without the leading '%'.
+template <typename OnLiteral, typename OnMacro>
+void scan_macros(std::string_view text, OnLiteral&& onLiteral, OnMacro&& onMacro) {
+    const char* const end = text.data() + text.size();
+    const char* literalStart = text.data();
+    const char* p = literalStart;
+
+    while ((p = find_macro_marker(p, end)) != end) {
+        const char* nameStart = p + 1;
+        if (nameStart == end || !is_macro_name_start(*nameStart)) {
+            ++p;
+            continue;
+        }
+
+        const char* nameEnd = nameStart + 1;
+        while (nameEnd != end && is_macro_name_char(*nameEnd)) {
+            ++nameEnd;
+        }
+
+        onLiteral(std::string_view(literalStart, static_cast<size_t>(p - literalStart)));
+        onMacro(std::string_view(nameStart, static_cast<size_t>(nameEnd - nameStart)));
+        literalStart = p = nameEnd;
+    }
+
+    onLiteral(std::string_view(literalStart, static_cast<size_t>(end - literalStart)));
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "interpreter.h"
+#include "parser.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The resolved macro set of an interpreted layout, stored as one position
+// independent binary image:
+//
+//   header | macro records | hash buckets | string pool
+//
+// Integers are little-endian and every reference is a byte offset from the
+// start of the image, so a table written to disk can be mapped and used in
+// place without running the tokenizer, parser or interpreter again. Each record
+// holds the text to substitute for every backend, already resolved through the
+// backend value -> default -> lazy name fallback, next to the raw default and
+// which backends were set explicitly (needed for macros.json).
+//
+// Copies share the underlying image; a table is immutable and safe to read
+// from several threads.
+class MacroTable {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 2;
+    static constexpr uint32_t NOT_FOUND = 0xFFFFFFFFu;
+
+    // An empty table.
+    MacroTable() = default;
+
+    static MacroTable build(const std::map<std::string, Macro>& macros,
+                            const std::set<Backend>& requiredBackends);
+
+    // Maps a table file written by write() (see MappedFile).
+    // Throws std::runtime_error if the file is not a valid table of this version.
+    static MacroTable open(const std::string& path);
+    static MacroTable from_image(std::string image);
+
+    void write(const std::string& path) const;
+
+    // Index of the macro called `name`, or NOT_FOUND.
+    uint32_t find(std::string_view name) const;
+
+    // Text that replaces the macro for `backend`. Returns false when the macro
+    // has neither a value for the backend, a default, nor lazy mode, or when the
+    // backend is not generated and its read_* file was never loaded.
+    bool value(uint32_t index, Backend backend, std::string_view& text) const;
+
+    size_t size() const;
+    std::string_view name(uint32_t index) const;
+    std::vector<Backend> required_backends() const;
+
+    // The same JSON as Interpreter::export_macro_metadata writes.
+    std::string metadata_json() const;
+    void export_metadata(const std::string& outputPath) const;
+
+    // The raw table bytes.
+    std::string_view image() const;
+
+private:
+    std::shared_ptr<const void> storage;
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+
+    uint32_t macroCount = 0;
+    uint32_t bucketMask = 0;
+    uint32_t backendMask = 0;
+    uint64_t recordsOffset = 0;
+    uint64_t bucketsOffset = 0;
+
+    static MacroTable attach(std::shared_ptr<const void> storage, const unsigned char* data, size_t length);
+
+    const unsigned char* record(uint32_t index) const;
+    std::string_view string_at(const unsigned char* ref) const;
+};
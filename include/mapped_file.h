@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only contents of a file, memory-mapped where the platform supports it
+// and read into memory otherwise. The contents stay valid as long as the
+// MappedFile does.
+class MappedFile {
+public:
+    // Returns nullptr if the file cannot be opened. Files smaller than
+    // `minMapSize` are read into memory instead of mapped.
+    static std::shared_ptr<const MappedFile> open(const std::string& path, size_t minMapSize = 0);
+
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view contents() const;
+
+private:
+    MappedFile() = default;
+
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string buffer; // used when the file is not mapped
+};
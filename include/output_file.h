@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+enum class WriteStatus {
+    Written,
+    Unchanged, // the file already held these bytes and was left alone, mtime included
+    Failed,
+};
+
+// Writes every generated file. A file that already holds exactly these bytes is not
+// touched, so downstream tools keyed on mtime do not rebuild. Otherwise the new
+// contents go to a temporary file in the same directory that is renamed over
+// the old one, so readers never see a partially written file.
+WriteStatus write_if_changed(const std::string& path, std::string_view contents);
+
+// True when `path` exists with exactly `contents`, compared byte for byte.
+bool file_has_contents(const std::string& path, std::string_view contents);
+
+// For outputs written piece by piece: write to temporary_path(path), then call
+// commit_temporary() to move it into place or discard it if nothing changed.
+std::string temporary_path(const std::string& path);
+WriteStatus commit_temporary(const std::string& temporaryPath, const std::string& path);
+
+// Makes `path` a hard link to `target`, which holds `contents`, replacing whatever
+// was there atomically. Falls back to write_if_changed() when the filesystem
+// cannot link, e.g. across devices.
+WriteStatus link_or_copy(const std::string& target, const std::string& path, std::string_view contents);
@@ -1,9 +1,10 @@
 #pragma once
+#include "arena.h"
 #include "tokenizer.h"
-#include <memory>
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <map>
+#include <string_view>
 
 enum class Backend {
     GLSL,
@@ -13,66 +14,87 @@ enum class Backend {
     UNKNOWN
 };
 
-struct Statement {
-    virtual ~Statement() = default;
-};
-
-struct MacroDefStatement : public Statement {
-    std::string varName;
-    std::string macroName;
-};
-
-struct SetStatement : public Statement {
-    std::string varName;
-    std::string backend;
-    std::vector<std::string> parts;
-    std::vector<bool> isLiteral;
-    bool isReadFromFile = false;
-};
-
-struct StringDeclaration : public Statement {
-    std::string name;
-    std::string expression;
-};
-
-struct SetDefaultStatement : public Statement {
-    std::string varName;
-    std::vector<std::string> parts;
-    std::vector<bool> isLiteral;
-    bool isReadFromFile = false;
+// Number of real backends; arrays indexed by Backend have this many entries.
+constexpr size_t BACKEND_COUNT = static_cast<size_t>(Backend::UNKNOWN);
+
+// Lowercase name used for output extensions and set_*/read_* suffixes, e.g. "glsl".
+const char* backend_name(Backend backend);
+// Accepts either case; returns Backend::UNKNOWN for anything else.
+Backend backend_from_name(const std::string& name);
+
+enum class StatementKind : uint8_t {
+    MacroDef,
+    Set,
+    SetDefault,
+    Lazy,
+    Boolean,
+    If,
+    GenerateAll,
+    GenerateSelect,
+    Print,
+    String
 };
 
-struct LazyStatement : public Statement {
-    std::string varName;
-};
+// Half-open range of indices into one of Program's arrays.
+struct IndexRange {
+    uint32_t begin = 0;
+    uint32_t end = 0;
 
-struct BooleanDeclaration : public Statement {
-    std::string name;
-    bool value;
+    uint32_t size() const { return end - begin; }
 };
 
-struct IfStatement : public Statement {
-    std::string conditionVar;
-    std::vector<std::shared_ptr<Statement>> body;
+// Operand of set_*/read_*: a string literal or the name of a string variable.
+struct ValuePart {
+    std::string_view text;
+    bool isLiteral;
 };
 
-struct GenerateAllStatement : public Statement {};
-struct GenerateSelectStatement : public Statement {
-    std::vector<Backend> backends;
+// One node of the flat AST. Which fields are used depends on kind:
+//   MacroDef        name = variable, text = macro name
+//   Set             name = variable, text = backend, range = parts, flag = read from file
+//   SetDefault      name = variable, range = parts, flag = read from file
+//   Lazy            name = variable
+//   Boolean         name, flag = value
+//   If              name = condition variable, range = body statements
+//   GenerateAll     -
+//   GenerateSelect  range = backends
+//   Print           text = expression, e.g. list_backends
+//   String          name, text = expression
+struct Statement {
+    StatementKind kind;
+    bool flag = false;
+    std::string_view name;
+    std::string_view text;
+    IndexRange range;
 };
 
-struct PrintStatement : public Statement {
-    std::string expression;  // e.g., SYSTEM->list_backends()
+// A parsed layout. Statements of one block are stored next to each other, so an
+// if body is a contiguous range; nested blocks come before the block holding them.
+// The arrays and all text live in the program's arena and are released together
+// with it.
+struct Program {
+    ArenaArray<Statement> statements;
+    ArenaArray<ValuePart> parts;
+    ArenaArray<Backend> backends;
+    IndexRange root;
+    Arena arena;
 };
 
+// Parses a token stream without copying it; `tokens` must outlive the Parser.
 class Parser {
 public:
     explicit Parser(const std::vector<Token>& tokens);
-    std::vector<std::shared_ptr<Statement>> parse();
+    explicit Parser(std::vector<Token>&&) = delete;
+    Program parse();
 
 private:
-    std::vector<Token> tokens;
+    const std::vector<Token>& tokens;
     size_t current;
+    Program program;
+    // Built up while parsing, then copied into the program arena in one piece each.
+    std::vector<Statement> statementList;
+    std::vector<ValuePart> partList;
+    std::vector<Backend> backendList;
 
     const Token& peek() const;
     const Token& previous() const;
@@ -81,15 +103,20 @@ private:
     bool check(TokenType type) const;
     void consume(TokenType type, const std::string& errorMessage);
 
-    std::shared_ptr<Statement> parse_statement();
-    std::shared_ptr<Statement> parse_macro_def();
-    std::shared_ptr<Statement> parse_set_or_read();
-    std::shared_ptr<Statement> parse_lazy();
-    std::shared_ptr<Statement> parse_boolean();
-    std::shared_ptr<Statement> parse_if();
-    std::shared_ptr<Statement> parse_generate();
-    std::shared_ptr<Statement> parse_print();
-    std::shared_ptr<Statement> parse_string();
-
-    Backend parse_backend_enum(const std::string& value);
+    // Owned copy of a token's text in the program arena, escapes resolved.
+    std::string_view intern(const Token& token);
+    // Appends a finished block to statementList and returns where it landed.
+    IndexRange append_block(const std::vector<Statement>& block);
+
+    Statement parse_statement();
+    Statement parse_macro_def();
+    Statement parse_set_or_read();
+    Statement parse_lazy();
+    Statement parse_boolean();
+    Statement parse_if();
+    Statement parse_generate();
+    Statement parse_print();
+    Statement parse_string();
+
+    Backend parse_backend_enum(std::string_view value);
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include "cli_options.h"
+#include "interpreter.h"
+#include "macro_table.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interprets a layout once per combination of selected booleans (the axes).
+// The layout is parsed once; statements before the first one that declares or
+// tests an axis run once, and each combination continues from a copy of that
+// interpreter state.
+//
+// build() renders every shader for every variant. Outputs are content-addressed
+// under <output_dir>/blobs, so variants that produce identical bytes share one
+// file, and <output_dir>/permutations.json maps each combination to its files.
+class PermutationSweep {
+public:
+    static constexpr size_t MAX_AXES = 16;
+
+    struct Variant {
+        std::vector<bool> values; // one per axis
+        MacroTable table;
+    };
+
+    // Throws std::runtime_error if an axis is not a boolean declared in the layout.
+    // `lazyReads` is as for Layout::compile().
+    PermutationSweep(std::string_view layoutSource, std::vector<std::string> axes, FileLoader loader = nullptr,
+                     bool lazyReads = false);
+
+    const std::vector<std::string>& axes() const;
+    const std::vector<Variant>& variants() const;
+
+    void build(const std::vector<ShaderJob>& jobs, unsigned threadCount = 1) const;
+
+private:
+    std::vector<std::string> axisNames;
+    std::vector<Variant> variantList;
+    // Index of the first variant with the same table, so each distinct table is rendered once.
+    std::vector<size_t> firstWithTable;
+};
@@ -1,11 +1,46 @@
 #pragma once
 #include "interpreter.h"
+#include "shader_template.h"
+#include <iosfwd>
 #include <string>
+#include <string_view>
 
 class ShaderProcessor {
 public:
     static void process_shader(const std::string& inputShaderPath,
                                const std::string& outputPath,
                                const std::map<std::string, Macro>& macros,
-                               const std::string& backendName);
+                               Backend backend);
+
+    // Renders an already loaded shader, so several backends can share one read and scan.
+    static void process_shader(const ShaderTemplate& shader,
+                               const std::string& outputPath,
+                               const std::map<std::string, Macro>& macros,
+                               Backend backend,
+                               std::vector<std::string>* warnings = nullptr);
+    static void process_shader(const ShaderTemplate& shader,
+                               const std::string& outputPath,
+                               const MacroTable& table,
+                               Backend backend,
+                               std::vector<std::string>* warnings = nullptr);
+
+    // Reads and scans a shader file once.
+    static ShaderTemplate load_shader(const std::string& inputShaderPath);
+    static std::string read_shader(const std::string& inputShaderPath);
+
+    // Expands `in` into `out` chunk by chunk, holding at most one chunk plus the
+    // longest macro name in memory, so it works on pipes and on shaders larger
+    // than RAM. A %MACRO split across two chunks is carried over and expanded
+    // whole; a name longer than any in the table is dropped as undefined without
+    // being carried, and only its text is kept for the warning.
+    static constexpr size_t STREAM_CHUNK_SIZE = 1 << 16;
+    static void stream_shader(std::istream& in, std::ostream& out,
+                              const MacroTable& table, Backend backend,
+                              std::vector<std::string>* warnings = nullptr,
+                              size_t chunkSize = STREAM_CHUNK_SIZE);
+
+    // Expands every %MACRO in shaderCode for the given backend and returns the result.
+    static std::string expand_shader(std::string_view shaderCode,
+                                     const std::map<std::string, Macro>& macros,
+                                     Backend backend);
 };
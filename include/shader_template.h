@@ -0,0 +1,67 @@
+#pragma once
+#include "interpreter.h"
+#include "macro_table.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reports a %NAME that expands to nothing: `defined` tells an unknown macro from one
+// without a value for the backend. Goes to `warnings` when given and std::cerr otherwise.
+void report_unresolved_macro(std::string_view name, bool defined, Backend backend,
+                             std::vector<std::string>* warnings);
+
+// One distinct macro a shader references and the byte offset of each of its
+// %NAME occurrences in the shader source.
+struct MacroUsage {
+    std::string name;
+    std::vector<size_t> offsets;
+};
+
+// A shader scanned once into literal spans and macro slots.
+// Rendering for a backend only copies spans and resolved macro values, so a
+// shader read from disk once can be emitted for every backend without rescanning.
+class ShaderTemplate {
+public:
+    static ShaderTemplate compile(std::string source);
+
+    // Expands the shader for one backend. Warnings about unresolved macros go to
+    // `warnings` when given and to std::cerr otherwise. `substitutions`, when
+    // given, receives the number of references that resolved to a value.
+    std::string render(const std::map<std::string, Macro>& macros, Backend backend,
+                       std::vector<std::string>* warnings = nullptr, size_t* substitutions = nullptr) const;
+    std::string render(const MacroTable& table, Backend backend,
+                       std::vector<std::string>* warnings = nullptr, size_t* substitutions = nullptr) const;
+
+    // Binary form persisted by BuildCache. deserialize() returns false for data
+    // that is truncated, corrupt or from another format version.
+    std::string serialize() const;
+    static bool deserialize(std::string_view data, ShaderTemplate& shader);
+
+    const std::string& source() const;
+    const std::vector<std::string>& macro_names() const;
+    size_t slot_count() const;
+    // Macros in order of first use, with where each one occurs.
+    std::vector<MacroUsage> usage() const;
+
+private:
+    struct Span {
+        size_t offset;
+        size_t length;
+    };
+
+    // How one distinct macro resolved for the backend being rendered.
+    struct Resolved {
+        bool defined = false;
+        bool hasValue = false;
+        std::string_view value;
+    };
+
+    std::string emit(const std::vector<Resolved>& resolved, Backend backend,
+                     std::vector<std::string>* warnings, size_t* substitutions) const;
+
+    std::string text;
+    std::vector<Span> literals;          // slots.size() + 1 spans into text
+    std::vector<uint32_t> slots;         // index into names for each %MACRO occurrence
+    std::vector<std::string> names;      // distinct macro names, in order of first use
+};
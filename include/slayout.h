@@ -0,0 +1,56 @@
+#pragma once
+#include "build_stats.h"
+#include "interpreter.h"
+#include "macro_table.h"
+#include "parser.h"
+#include "shader_template.h"
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// In-memory entry point for embedding the compiler, e.g. for runtime shader
+// hot-reload. A Layout is compiled once from source; expanding shaders against
+// it works purely on strings and never touches the filesystem.
+//
+//     Layout layout = Layout::compile(layoutSource, [](const std::string& path) { return assets.read(path); });
+//     std::string glsl = layout.expand(shaderSource, Backend::GLSL);
+class Layout {
+public:
+    // Tokenizes, parses and interprets layout source. read_* statements go through
+    // `loader`; without one they read from disk relative to the working directory.
+    // With `lazyReads`, files only a backend the layout does not generate would use
+    // are not loaded, and the table records their paths instead of their contents.
+    // With `stats`, each phase is timed and token, statement and macro counts recorded.
+    static Layout compile(std::string_view layoutSource, FileLoader loader = nullptr,
+                          BuildStats* stats = nullptr, bool lazyReads = false);
+
+    // Maps a table written by write_table() (or slayoutc --emit-table) without
+    // running the tokenizer, parser or interpreter.
+    static Layout open_table(const std::string& path);
+    void write_table(const std::string& path) const;
+
+    // Expands every %MACRO in the shader for one backend.
+    std::string expand(std::string_view shaderSource, Backend backend,
+                       std::vector<std::string>* warnings = nullptr) const;
+    std::string expand(const ShaderTemplate& shader, Backend backend,
+                       std::vector<std::string>* warnings = nullptr) const;
+
+    // Expands the shader for every backend the layout asks to generate, scanning it once.
+    std::map<Backend, std::string> expand_all(std::string_view shaderSource,
+                                              std::vector<std::string>* warnings = nullptr) const;
+
+    // Backends requested through generate_all()/generate_select().
+    std::vector<Backend> backends() const;
+
+    // Empty for layouts opened from a table.
+    const std::string& source() const;
+    const std::vector<LoadedFile>& loaded_files() const;
+
+    const MacroTable& table() const;
+
+private:
+    std::string layoutSource;
+    std::vector<LoadedFile> loadedFiles;
+    MacroTable macroTable;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool where every worker owns a task deque. Workers pop their own
+// newest task first and steal the oldest task from other workers when idle.
+// Tasks may submit further tasks; those land on the submitting worker's deque.
+// Only the deques are locked per task; the shared counters are atomics, and the
+// pool mutex is taken only to put a worker to sleep or to wake one.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished. Rethrows the first
+    // exception that escaped a task, if any.
+    void wait();
+
+    unsigned size() const;
+
+    // Thread count to use when the user asks for "all cores".
+    static unsigned default_thread_count();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    // Tasks pushed and not yet popped. Counted after the push and uncounted after
+    // the pop, so it can dip below zero for a moment.
+    std::atomic<int64_t> queued{0};
+    std::atomic<unsigned> sleepers{0}; // workers waiting on workAvailable
+    std::atomic<size_t> unfinished{0};
+    bool stopping = false;             // guarded by sleepMutex
+    std::exception_ptr firstError;     // guarded by sleepMutex
+
+    std::atomic<unsigned> nextQueue{0};
+
+    void worker_loop(unsigned index);
+    bool try_pop(unsigned index, std::function<void()>& task);
+};
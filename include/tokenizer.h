@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 
@@ -24,20 +25,27 @@ enum class TokenType {
     EndOfFile
 };
 
+// Tokens do not own their text: `value` points into the source buffer handed to
+// the Tokenizer, which must outlive them. For String tokens `value` is the raw
+// text between the quotes; use token_text() to get it with escapes resolved.
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
     int line;
     int column;
+    bool hasEscapes = false;
 };
 
+// Owned copy of a token's text, with backslash escapes in strings resolved.
+std::string token_text(const Token& token);
+
 class Tokenizer {
 public:
-    explicit Tokenizer(const std::string& source);
+    explicit Tokenizer(std::string_view source);
     std::vector<Token> tokenize();
 
 private:
-    std::string source;
+    std::string_view source;
     size_t pos;
     int line, column;
 
@@ -45,7 +53,7 @@ private:
     char advance();
     bool match(char expected);
     void skip_whitespace_and_comments();
-    Token make_token(TokenType type, const std::string& value);
+    Token make_token(TokenType type, std::string_view value, bool hasEscapes = false);
     Token string();
     Token identifier_or_keyword();
     Token symbol();
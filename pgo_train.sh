@@ -0,0 +1,48 @@
+#!/bin/bash
+# Builds a profile-guided slayoutc in build-pgo/:
+#   1. an instrumented build (SLAYOUT_PGO=GENERATE),
+#   2. a training run over a generated corpus and every example,
+#   3. the final build using the profiles (SLAYOUT_PGO=USE).
+# Extra arguments are passed to cmake, e.g. -DCMAKE_CXX_COMPILER=clang++.
+set -e
+
+BUILD_DIR="build-pgo"
+PGO_DIR="$PWD/$BUILD_DIR/pgo"
+TRAIN_DIR="$PWD/$BUILD_DIR/training"
+
+rm -rf "$PGO_DIR" "$TRAIN_DIR"
+mkdir -p "$PGO_DIR" "$TRAIN_DIR"
+
+echo "== Instrumented build"
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release -DSLAYOUT_PGO=GENERATE -DSLAYOUT_PGO_DIR="$PGO_DIR" "$@"
+cmake --build "$BUILD_DIR" --clean-first -j
+COMPILER="$PWD/$BUILD_DIR/bin/slayoutc"
+export LLVM_PROFILE_FILE="$PGO_DIR/slayout-%p.profraw"
+
+echo "== Training"
+"$PWD/$BUILD_DIR/bin/slayout_bench" --generate "$TRAIN_DIR/corpus" > /dev/null
+(
+    cd "$TRAIN_DIR/corpus"
+    "$COMPILER" layout.slayout --manifest shaders.txt out > /dev/null 2>&1
+    "$COMPILER" layout.slayout --manifest shaders.txt out -j > /dev/null 2>&1
+    "$COMPILER" layout.slayout --emit-table layout.sltable > /dev/null
+    "$COMPILER" layout.sltable --manifest shaders.txt out > /dev/null 2>&1
+    "$COMPILER" layout.slayout --manifest shaders.txt out --cache cache > /dev/null 2>&1
+    "$COMPILER" layout.slayout shaders/shader0.shader - --backend glsl < /dev/null > /dev/null 2>&1
+)
+for dir in examples/*/; do
+    SFILE=$(find "$dir" -name "*.slayout" | head -n 1)
+    SHADER=$(find "$dir" -name "*.shader" | head -n 1)
+    [ -n "$SFILE" ] && [ -n "$SHADER" ] || continue
+    "$COMPILER" "$SFILE" "$SHADER" "$TRAIN_DIR/examples/$(basename "$dir")" > /dev/null 2>&1
+done
+
+if ls "$PGO_DIR"/*.profraw > /dev/null 2>&1; then
+    PROFDATA=$(command -v llvm-profdata || xcrun --find llvm-profdata)
+    "$PROFDATA" merge -o "$PGO_DIR/slayout.profdata" "$PGO_DIR"/*.profraw
+fi
+
+echo "== Optimized build"
+cmake -S . -B "$BUILD_DIR" -DSLAYOUT_PGO=USE "$@"
+cmake --build "$BUILD_DIR" --clean-first -j
+echo "Profile-guided build in $BUILD_DIR/bin"
@@ -0,0 +1,35 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstring>
+
+Arena::Arena(size_t blockSize)
+    : blockSize(blockSize) {}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    if (cursor == nullptr || padding + size > remaining) {
+        // Oversized requests get a block of their own.
+        size_t capacity = size + alignment > blockSize ? size + alignment : blockSize;
+        blocks.push_back(std::make_unique<char[]>(capacity));
+        cursor = blocks.back().get();
+        remaining = capacity;
+        padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    }
+
+    char* result = cursor + padding;
+    cursor = result + size;
+    remaining -= padding + size;
+    used += size;
+    return result;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    if (text.empty()) return {};
+    char* data = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return std::string_view(data, text.size());
+}
+
+size_t Arena::bytes_allocated() const {
+    return used;
+}
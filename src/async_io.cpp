@@ -0,0 +1,168 @@
+#include "async_io.h"
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct AsyncIO::Request {
+    std::string path;
+    std::string data; // contents to write, or the contents read
+    bool isWrite = false;
+    std::promise<std::string> readDone;
+    std::promise<WriteStatus> writeDone;
+    WriteStatus status = WriteStatus::Written;
+};
+
+class AsyncIO::Engine {
+public:
+    using Finish = std::function<void(std::unique_ptr<Request>, std::exception_ptr)>;
+
+    explicit Engine(Finish finish) : finish(std::move(finish)) {}
+    virtual ~Engine() = default;
+
+    virtual void submit(std::unique_ptr<Request> request) = 0;
+
+protected:
+    Finish finish;
+};
+
+namespace {
+
+std::runtime_error io_error(const AsyncIO::Request& request) {
+    return std::runtime_error(request.isWrite ? "Failed to write to output: " + request.path
+                                              : "Failed to read file: " + request.path);
+}
+
+// Blocking reads and writes on a few threads. The AsyncIO slot limit keeps the
+// queue bounded.
+class ThreadEngine : public AsyncIO::Engine {
+public:
+    static constexpr unsigned THREAD_COUNT = 4;
+
+    explicit ThreadEngine(Finish finish) : Engine(std::move(finish)) {
+        for (unsigned i = 0; i < THREAD_COUNT; ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    void submit(std::unique_ptr<AsyncIO::Request> request) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(request));
+        }
+        available.notify_one();
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::unique_ptr<AsyncIO::Request>> pending;
+    bool stopping = false;
+
+    void run() {
+        while (true) {
+            std::unique_ptr<AsyncIO::Request> request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (pending.empty()) return;
+                request = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            bool ok = request->isWrite ? write_file(*request) : read_file(*request);
+            std::exception_ptr error = ok ? nullptr : std::make_exception_ptr(io_error(*request));
+            finish(std::move(request), error);
+        }
+    }
+
+    static bool read_file(AsyncIO::Request& request) {
+        std::ifstream file(request.path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+        std::streamoff size = file.tellg();
+        if (size < 0) return false;
+        request.data.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        file.read(&request.data[0], size);
+        return static_cast<bool>(file) || size == 0;
+    }
+
+    static bool write_file(AsyncIO::Request& request) {
+        request.status = write_if_changed(request.path, request.data);
+        return request.status != WriteStatus::Failed;
+    }
+};
+
+} // namespace
+
+AsyncIO::AsyncIO(unsigned queueDepth)
+    : queueDepth(queueDepth == 0 ? 1 : queueDepth) {
+    auto finishRequest = [this](std::unique_ptr<Request> request, std::exception_ptr error) {
+        finish(std::move(request), error);
+    };
+    engine = std::make_unique<ThreadEngine>(finishRequest);
+}
+
+AsyncIO::~AsyncIO() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFree.wait(lock, [this] { return inFlight == 0; });
+    }
+    engine.reset();
+}
+
+std::future<std::string> AsyncIO::read(std::string path) {
+    auto request = std::make_unique<Request>();
+    request->path = std::move(path);
+    std::future<std::string> result = request->readDone.get_future();
+    submit(std::move(request));
+    return result;
+}
+
+std::future<WriteStatus> AsyncIO::write(std::string path, std::string contents) {
+    auto request = std::make_unique<Request>();
+    request->path = std::move(path);
+    request->data = std::move(contents);
+    request->isWrite = true;
+    std::future<WriteStatus> result = request->writeDone.get_future();
+    submit(std::move(request));
+    return result;
+}
+
+void AsyncIO::submit(std::unique_ptr<Request> request) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFree.wait(lock, [this] { return inFlight < queueDepth; });
+        ++inFlight;
+    }
+    engine->submit(std::move(request));
+}
+
+void AsyncIO::finish(std::unique_ptr<Request> request, std::exception_ptr error) {
+    if (request->isWrite) {
+        if (error) request->writeDone.set_exception(error);
+        else request->writeDone.set_value(request->status);
+    } else {
+        if (error) request->readDone.set_exception(error);
+        else request->readDone.set_value(std::move(request->data));
+    }
+    request.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --inFlight;
+    }
+    slotFree.notify_all();
+}
@@ -0,0 +1,54 @@
+#include "blob_store.h"
+#include "hash.h"
+#include "output_file.h"
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+BlobStore::BlobStore(std::string directory)
+    : root(std::move(directory)) {}
+
+std::string BlobStore::put(std::string_view contents, std::string_view extension) {
+    std::string name = hash_to_hex(hash64(contents));
+    name += extension;
+    std::string path = (fs::path(root) / name).string();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (names.empty()) fs::create_directories(root);
+        // Later callers wait for the first one, so the blob exists when they link to it.
+        auto it = names.find(name);
+        while (it != names.end() && !it->second) {
+            blobWritten.wait(lock);
+            it = names.find(name);
+        }
+        if (it != names.end()) {
+            lock.unlock();
+            if (!file_has_contents(path, contents)) {
+                throw std::runtime_error("Different outputs hash to the same blob: " + path);
+            }
+            return name;
+        }
+        names.emplace(name, false);
+    }
+
+    // Blobs left by an earlier run are kept as they are when they hold these bytes.
+    bool written = write_if_changed(path, contents) != WriteStatus::Failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (written) names[name] = true;
+        else names.erase(name);
+    }
+    blobWritten.notify_all();
+    if (!written) throw std::runtime_error("Failed to write to output: " + path);
+    return name;
+}
+
+const std::string& BlobStore::directory() const {
+    return root;
+}
+
+size_t BlobStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return names.size();
+}
@@ -0,0 +1,322 @@
+#include "build_cache.h"
+#include "hash.h"
+#include "output_file.h"
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// Bump when the generated output for identical inputs changes.
+static constexpr uint64_t CACHE_FORMAT_VERSION = 3;
+static const char* const INDEX_HEADER = "slayout-cache 1";
+static const char* const SHADER_INDEX_HEADER = "slayout-shaders 1";
+static const char* const USAGE_INDEX_HEADER = "slayout-usage 1";
+static const char* const MACRO_INDEX_HEADER = "slayout-macros 1";
+
+// Stand-ins for value hashes of macros that resolve to nothing.
+static constexpr uint64_t NO_VALUE_HASH = 1;
+static constexpr uint64_t UNKNOWN_MACRO_HASH = 2;
+
+// An interrupted run never leaves a truncated index or template.
+static void write_atomically(const std::string& path, const std::string& contents) {
+    if (write_if_changed(path, contents) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write build cache: " + path);
+    }
+}
+
+static bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec) return false;
+    auto time = fs::last_write_time(path, ec);
+    if (ec) return false;
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+// Opens an index and checks its header; false when it is missing or from another version.
+static bool open_index(const std::string& path, const char* header, std::ifstream& file) {
+    file.open(path);
+    std::string line;
+    return file.is_open() && std::getline(file, line) && line == header;
+}
+
+BuildCache::BuildCache(std::string directory)
+    : directory(std::move(directory)) {
+    std::ifstream file;
+    std::string line;
+    if (!open_index(index_path(), INDEX_HEADER, file)) return;
+
+    while (std::getline(file, line)) {
+        size_t space = line.find(' ');
+        uint64_t key;
+        if (space == std::string::npos || !hash_from_hex(std::string_view(line).substr(0, space), key)) {
+            continue;
+        }
+        entries[line.substr(space + 1)] = key;
+    }
+
+    std::ifstream shaderFile;
+    if (open_index(shader_index_path(), SHADER_INDEX_HEADER, shaderFile)) {
+        while (std::getline(shaderFile, line)) {
+            std::istringstream fields(line);
+            std::string hex, path;
+            ShaderEntry entry;
+            if (!(fields >> hex >> entry.size >> entry.mtime) || !hash_from_hex(hex, entry.hash) ||
+                fields.get() != ' ' || !std::getline(fields, path)) {
+                continue;
+            }
+            shaders[path] = entry;
+        }
+    }
+
+    // "<shader hash>" alone for a shader without macros, otherwise one
+    // "<shader hash> <name> <offset>,<offset>..." line per macro.
+    std::ifstream usageFile;
+    if (open_index(usage_index_path(), USAGE_INDEX_HEADER, usageFile)) {
+        while (std::getline(usageFile, line)) {
+            std::istringstream fields(line);
+            std::string hex, offsets;
+            uint64_t hash;
+            if (!(fields >> hex) || !hash_from_hex(hex, hash)) continue;
+
+            std::vector<MacroUsage>& usage = usages[hash];
+            MacroUsage macro;
+            if (!(fields >> macro.name >> offsets)) continue;
+            std::istringstream offsetFields(offsets);
+            std::string offset;
+            size_t value;
+            while (std::getline(offsetFields, offset, ',') &&
+                   std::from_chars(offset.data(), offset.data() + offset.size(), value).ec == std::errc()) {
+                macro.offsets.push_back(value);
+            }
+            usage.push_back(std::move(macro));
+        }
+    }
+
+    // "<name> <value hash per backend>..."
+    std::ifstream macroFile;
+    if (open_index(macro_index_path(), MACRO_INDEX_HEADER, macroFile)) {
+        while (std::getline(macroFile, line)) {
+            std::istringstream fields(line);
+            std::string name, hex;
+            std::vector<uint64_t> hashes;
+            uint64_t hash;
+            if (!(fields >> name)) continue;
+            while (fields >> hex && hash_from_hex(hex, hash)) {
+                hashes.push_back(hash);
+            }
+            if (hashes.size() == BACKEND_COUNT) macroValues[name] = std::move(hashes);
+        }
+    }
+}
+
+bool BuildCache::is_fresh(const std::string& outputPath, uint64_t key) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(outputPath);
+        if (it == entries.end() || it->second != key) return false;
+    }
+    std::error_code ec;
+    return fs::is_regular_file(outputPath, ec);
+}
+
+void BuildCache::record(const std::string& outputPath, uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[outputPath] = key;
+}
+
+bool BuildCache::shader_hash(const std::string& shaderPath, uint64_t& hash) const {
+    uint64_t size;
+    int64_t mtime;
+    if (!stat_file(shaderPath, size, mtime)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = shaders.find(shaderPath);
+    if (it == shaders.end() || it->second.mtime == 0 ||
+        it->second.size != size || it->second.mtime != mtime) {
+        return false;
+    }
+    hash = it->second.hash;
+    return true;
+}
+
+void BuildCache::record_shader(const std::string& shaderPath, uint64_t hash) {
+    ShaderEntry entry{hash, 0, 0};
+    if (stat_file(shaderPath, entry.size, entry.mtime)) {
+        // A file modified within the timestamp resolution of this run could change
+        // again without its mtime moving; keep the hash but re-read it next time.
+        auto age = fs::file_time_type::clock::now().time_since_epoch().count() - entry.mtime;
+        if (age < std::chrono::duration_cast<fs::file_time_type::duration>(std::chrono::seconds(2)).count()) {
+            entry.mtime = 0;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    shaders[shaderPath] = entry;
+}
+
+bool BuildCache::load_template(uint64_t shaderHash, ShaderTemplate& shader) const {
+    std::ifstream file(template_path(shaderHash), std::ios::binary);
+    if (!file.is_open()) return false;
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return ShaderTemplate::deserialize(buffer.str(), shader);
+}
+
+void BuildCache::store_template(uint64_t shaderHash, const ShaderTemplate& shader) const {
+    fs::create_directories(fs::path(directory) / "templates");
+    write_atomically(template_path(shaderHash), shader.serialize());
+}
+
+bool BuildCache::usage(uint64_t shaderHash, std::vector<MacroUsage>& usage) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = usages.find(shaderHash);
+    if (it == usages.end()) return false;
+    usage = it->second;
+    return true;
+}
+
+void BuildCache::record_usage(uint64_t shaderHash, std::vector<MacroUsage> usage) {
+    std::lock_guard<std::mutex> lock(mutex);
+    usages[shaderHash] = std::move(usage);
+}
+
+std::vector<std::string> BuildCache::record_macros(const MacroTable& table, const std::vector<uint64_t>& valueHashes) {
+    std::map<std::string, std::vector<uint64_t>> current;
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        current[std::string(table.name(i))].assign(valueHashes.begin() + i * BACKEND_COUNT,
+                                                   valueHashes.begin() + (i + 1) * BACKEND_COUNT);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> changed;
+    if (!macroValues.empty()) {
+        for (const auto& [name, hashes] : current) {
+            auto it = macroValues.find(name);
+            if (it == macroValues.end() || it->second != hashes) changed.push_back(name);
+        }
+        for (const auto& [name, hashes] : macroValues) {
+            if (!current.count(name)) changed.push_back(name);
+        }
+    }
+    macroValues = std::move(current);
+    return changed;
+}
+
+void BuildCache::save() const {
+    fs::create_directories(directory);
+
+    std::ostringstream out;
+    std::ostringstream shaderOut;
+    std::ostringstream usageOut;
+    std::ostringstream macroOut;
+    std::set<std::string> liveTemplates;
+    out << INDEX_HEADER << "\n";
+    shaderOut << SHADER_INDEX_HEADER << "\n";
+    usageOut << USAGE_INDEX_HEADER << "\n";
+    macroOut << MACRO_INDEX_HEADER << "\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& [path, key] : entries) {
+            out << hash_to_hex(key) << " " << path << "\n";
+        }
+        std::set<uint64_t> liveShaders;
+        for (const auto& [path, entry] : shaders) {
+            shaderOut << hash_to_hex(entry.hash) << " " << entry.size << " " << entry.mtime << " " << path << "\n";
+            liveTemplates.insert(fs::path(template_path(entry.hash)).filename().string());
+            liveShaders.insert(entry.hash);
+        }
+        for (const auto& [hash, usage] : usages) {
+            if (!liveShaders.count(hash)) continue;
+            if (usage.empty()) usageOut << hash_to_hex(hash) << "\n";
+            for (const auto& macro : usage) {
+                usageOut << hash_to_hex(hash) << " " << macro.name << " ";
+                for (size_t i = 0; i < macro.offsets.size(); ++i) {
+                    usageOut << (i ? "," : "") << macro.offsets[i];
+                }
+                usageOut << "\n";
+            }
+        }
+        for (const auto& [name, hashes] : macroValues) {
+            macroOut << name;
+            for (uint64_t hash : hashes) macroOut << " " << hash_to_hex(hash);
+            macroOut << "\n";
+        }
+    }
+
+    write_atomically(index_path(), out.str());
+    write_atomically(shader_index_path(), shaderOut.str());
+    write_atomically(usage_index_path(), usageOut.str());
+    write_atomically(macro_index_path(), macroOut.str());
+
+    std::error_code ec;
+    for (const auto& file : fs::directory_iterator(fs::path(directory) / "templates", ec)) {
+        if (!liveTemplates.count(file.path().filename().string())) {
+            fs::remove(file.path(), ec);
+        }
+    }
+}
+
+uint64_t BuildCache::layout_key(const MacroTable& table) {
+    return hash_combine(CACHE_FORMAT_VERSION, hash64(table.image()));
+}
+
+std::vector<uint64_t> BuildCache::value_hashes(const MacroTable& table) {
+    std::vector<uint64_t> hashes(static_cast<size_t>(table.size()) * BACKEND_COUNT);
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+            std::string_view value;
+            hashes[i * BACKEND_COUNT + b] = table.value(i, static_cast<Backend>(b), value) ? hash64(value) : NO_VALUE_HASH;
+        }
+    }
+    return hashes;
+}
+
+uint64_t BuildCache::usage_key(const std::vector<MacroUsage>& usage, const MacroTable& table,
+                               const std::vector<uint64_t>& valueHashes, Backend backend) {
+    uint64_t key = 0;
+    for (const auto& macro : usage) {
+        uint32_t index = table.find(macro.name);
+        uint64_t valueHash = index == MacroTable::NOT_FOUND
+            ? UNKNOWN_MACRO_HASH
+            : valueHashes[index * BACKEND_COUNT + static_cast<size_t>(backend)];
+        key = hash_combine(hash_combine(key, hash64(macro.name)), valueHash);
+    }
+    return key;
+}
+
+uint64_t BuildCache::output_key(uint64_t shaderHash, Backend backend, uint64_t usageKey) {
+    uint64_t key = hash_combine(CACHE_FORMAT_VERSION, shaderHash);
+    return hash_combine(hash_combine(key, hash64(backend_name(backend))), usageKey);
+}
+
+uint64_t BuildCache::metadata_key(uint64_t layoutKey) {
+    return hash_combine(layoutKey, hash64("macros.json"));
+}
+
+std::string BuildCache::index_path() const {
+    return (fs::path(directory) / "outputs.idx").string();
+}
+
+std::string BuildCache::shader_index_path() const {
+    return (fs::path(directory) / "shaders.idx").string();
+}
+
+std::string BuildCache::usage_index_path() const {
+    return (fs::path(directory) / "usage.idx").string();
+}
+
+std::string BuildCache::macro_index_path() const {
+    return (fs::path(directory) / "macros.idx").string();
+}
+
+std::string BuildCache::template_path(uint64_t shaderHash) const {
+    return (fs::path(directory) / "templates" / (hash_to_hex(shaderHash) + ".slt")).string();
+}
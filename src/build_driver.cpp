@@ -0,0 +1,346 @@
+#include "build_driver.h"
+#include "async_io.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "shader_processor.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+BuildDriver::BuildDriver(const MacroTable& table, unsigned threadCount)
+    : table(table), backends(table.required_backends()), threadCount(threadCount) {}
+
+void BuildDriver::enable_cache(BuildCache& buildCache, uint64_t key) {
+    cache = &buildCache;
+    layoutKey = key;
+    valueHashes = BuildCache::value_hashes(table);
+    changedMacros = cache->record_macros(table, valueHashes).size();
+}
+
+void BuildDriver::enable_stats(BuildStats& buildStats) {
+    stats = &buildStats;
+}
+
+void BuildDriver::enable_dedup(BlobStore& store, bool link) {
+    blobs = &store;
+    linkOutputs = link;
+}
+
+void BuildDriver::enable_hashes() {
+    writeHashes = true;
+}
+
+// Outputs skipped by the cache keep the hash recorded when they were written, as long
+// as their size still matches; anything else is hashed from disk.
+static bool previous_hash(const nlohmann::json& previous, const std::string& name, const std::string& path,
+                          uint64_t& hash, size_t& size) {
+    std::error_code ec;
+    size = static_cast<size_t>(std::filesystem::file_size(path, ec));
+    if (ec) return false;
+
+    auto entry = previous.is_object() ? previous.find(name) : previous.end();
+    if (entry != previous.end() && entry->is_object() && entry->value("size", size_t(0)) == size &&
+        hash_from_hex(entry->value("xxh64", ""), hash)) {
+        return true;
+    }
+    auto file = MappedFile::open(path);
+    if (!file) return false;
+    hash = hash64(file->contents());
+    return true;
+}
+
+void BuildDriver::write_hashes(const ShaderJob& job, const TaskResult* jobResults, const std::vector<MacroUsage>& usage,
+                               uint64_t metadataHash, size_t metadataSize) const {
+    std::string path = job.outputDir + "/hashes.json";
+    nlohmann::json previous;
+    if (auto file = MappedFile::open(path)) {
+        previous = nlohmann::json::parse(file->contents(), nullptr, false);
+    }
+
+    nlohmann::json hashes;
+    for (size_t b = 0; b < backends.size(); ++b) {
+        const TaskResult& result = jobResults[b];
+        std::string name = std::string("shader.") + backend_name(backends[b]);
+        uint64_t hash = result.contentHash;
+        size_t size = result.contentSize;
+        if (result.upToDate && !previous_hash(previous, name, result.outputPath, hash, size)) {
+            throw std::runtime_error("Failed to read output: " + result.outputPath);
+        }
+
+        // Macros without a value for this backend are left as written and not listed.
+        nlohmann::json macros = nlohmann::json::array();
+        for (const auto& macro : usage) {
+            uint32_t index = table.find(macro.name);
+            std::string_view value;
+            if (index != MacroTable::NOT_FOUND && table.value(index, backends[b], value)) macros.push_back(macro.name);
+        }
+        hashes[name] = {{"xxh64", hash_to_hex(hash)}, {"size", size}, {"macros", std::move(macros)}};
+    }
+    hashes["macros.json"] = {{"xxh64", hash_to_hex(metadataHash)}, {"size", metadataSize}};
+
+    if (write_if_changed(path, hashes.dump(4)) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write to output: " + path);
+    }
+}
+
+// Blobs carry no extension: identical outputs for different backends share one file.
+std::string BuildDriver::store_output(const std::string& path, const std::string& contents) const {
+    std::string blob = blobs->put(contents, "");
+    if (linkOutputs) {
+        WriteStatus status = link_or_copy(blobs->directory() + "/" + blob, path, contents);
+        if (status == WriteStatus::Failed) throw std::runtime_error("Failed to write to output: " + path);
+        if (status == WriteStatus::Unchanged && stats) stats->add("outputs_unchanged");
+    }
+    return blob;
+}
+
+void BuildDriver::write_dedup_manifest(const std::vector<ShaderJob>& jobs, const std::vector<TaskResult>& results,
+                                       const std::vector<std::string>& metadataBlobs) const {
+    nlohmann::json manifest;
+    manifest["outputs"] = nlohmann::json::array();
+    size_t fileCount = 0;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        nlohmann::json files;
+        for (size_t b = 0; b < backends.size(); ++b) {
+            files[backend_name(backends[b])] = results[j * backends.size() + b].blob;
+        }
+        files["macros.json"] = metadataBlobs[j];
+        fileCount += files.size();
+        manifest["outputs"].push_back({{"shader", jobs[j].shaderPath}, {"output_dir", jobs[j].outputDir},
+                                       {"files", std::move(files)}});
+    }
+
+    std::string manifestPath = blobs->directory() + "/outputs.json";
+    if (write_if_changed(manifestPath, manifest.dump(4)) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write to output: " + manifestPath);
+    }
+    if (stats) stats->add("outputs_deduplicated", fileCount - blobs->size());
+    std::cout << "Generated: " << manifestPath << " (" << fileCount << " files, "
+              << blobs->size() << " distinct)\n";
+}
+
+// Shader sources are read this many jobs ahead of the one being expanded.
+static constexpr size_t READ_AHEAD = 8;
+
+void BuildDriver::build(const std::vector<ShaderJob>& jobs) const {
+    std::vector<ShaderTemplate> shaders(jobs.size());
+    std::vector<std::exception_ptr> loadErrors(jobs.size());
+    std::vector<std::exception_ptr> metadataErrors(jobs.size());
+    std::vector<std::future<WriteStatus>> metadataWrites(jobs.size());
+    std::vector<std::string> metadataBlobs(jobs.size());
+    std::vector<std::vector<MacroUsage>> usages(writeHashes ? jobs.size() : 0);
+
+    // macros.json is the same for every job and does not depend on the cache.
+    uint64_t metadataHash = 0;
+    size_t metadataSize = 0;
+    if (writeHashes) {
+        std::string metadata = table.metadata_json();
+        metadataHash = hash64(metadata);
+        metadataSize = metadata.size();
+    }
+    std::vector<TaskResult> results(jobs.size() * backends.size());
+
+    if (cache && stats) stats->add("macros_changed", changedMacros);
+
+    // Reads of upcoming shaders and writes of finished outputs overlap with
+    // expansion; declared before the pool so it outlives every task.
+    AsyncIO io;
+    std::vector<std::future<std::string>> sources(jobs.size());
+    std::mutex readAheadMutex;
+    size_t nextRead = 0;
+    auto read_ahead = [&](size_t upTo) {
+        std::lock_guard<std::mutex> lock(readAheadMutex);
+        for (; nextRead < std::min(upTo, jobs.size()); ++nextRead) {
+            // With a cache, shaders whose size and mtime are unchanged are usually not read at all.
+            uint64_t knownHash;
+            if (cache && cache->shader_hash(jobs[nextRead].shaderPath, knownHash)) continue;
+            sources[nextRead] = io.read(jobs[nextRead].shaderPath);
+        }
+    };
+    auto take_source = [&](size_t j) {
+        read_ahead(j + 1 + READ_AHEAD);
+        std::string source;
+        if (!sources[j].valid()) {
+            source = ShaderProcessor::read_shader(jobs[j].shaderPath);
+        } else {
+            try {
+                source = sources[j].get();
+            } catch (const std::exception&) {
+                throw std::runtime_error("Failed to open shader file: " + jobs[j].shaderPath);
+            }
+        }
+        if (stats) stats->add("shader_bytes_read", source.size());
+        return source;
+    };
+    read_ahead(READ_AHEAD);
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threadCount > 1 && jobs.size() * (backends.size() + 1) > 1) {
+        pool = std::make_unique<ThreadPool>(threadCount);
+    }
+    auto run = [&pool](std::function<void()> task) {
+        if (pool) pool->submit(std::move(task));
+        else task();
+    };
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        // Read and scan the shader once, then render it for every requested backend.
+        run([&, j] {
+            try {
+                BuildStats::Span span(stats, "load_shader", "shader", jobs[j].shaderPath);
+                if (!blobs || linkOutputs) std::filesystem::create_directories(jobs[j].outputDir);
+                if (!cache) {
+                    shaders[j] = ShaderTemplate::compile(take_source(j));
+                    if (writeHashes) usages[j] = shaders[j].usage();
+                } else {
+                    // An unchanged shader is neither read nor scanned: its hash comes from
+                    // the shader index and its template from the cache.
+                    std::string source;
+                    uint64_t shaderHash;
+                    bool haveSource = !cache->shader_hash(jobs[j].shaderPath, shaderHash);
+                    if (haveSource) {
+                        source = take_source(j);
+                        shaderHash = hash64(source);
+                        cache->record_shader(jobs[j].shaderPath, shaderHash);
+                    } else {
+                        read_ahead(j + 1 + READ_AHEAD);
+                    }
+
+                    bool haveTemplate = false;
+                    auto load_template = [&] {
+                        if (cache->load_template(shaderHash, shaders[j])) {
+                            if (stats) stats->add("shader_templates_from_cache");
+                        } else {
+                            if (!haveSource) {
+                                source = ShaderProcessor::read_shader(jobs[j].shaderPath);
+                                if (stats) stats->add("shader_bytes_read", source.size());
+                            }
+                            shaders[j] = ShaderTemplate::compile(std::move(source));
+                            cache->store_template(shaderHash, shaders[j]);
+                        }
+                        haveTemplate = true;
+                    };
+
+                    // Each output depends on the values of the macros its shader references,
+                    // so only outputs referencing a changed macro are rendered again.
+                    std::vector<MacroUsage> usage;
+                    if (!cache->usage(shaderHash, usage)) {
+                        load_template();
+                        usage = shaders[j].usage();
+                        cache->record_usage(shaderHash, usage);
+                    }
+                    if (writeHashes) usages[j] = usage;
+
+                    bool needsRender = false;
+                    for (size_t b = 0; b < backends.size(); ++b) {
+                        TaskResult& result = results[j * backends.size() + b];
+                        result.outputPath = jobs[j].outputDir + "/shader." + backend_name(backends[b]);
+                        uint64_t usageKey = BuildCache::usage_key(usage, table, valueHashes, backends[b]);
+                        result.key = BuildCache::output_key(shaderHash, backends[b], usageKey);
+                        result.upToDate = cache->is_fresh(result.outputPath, result.key);
+                        needsRender = needsRender || !result.upToDate;
+                    }
+                    if (needsRender && !haveTemplate) load_template();
+                }
+            } catch (...) {
+                loadErrors[j] = std::current_exception();
+                return;
+            }
+
+            for (size_t b = 0; b < backends.size(); ++b) {
+                if (results[j * backends.size() + b].upToDate) continue;
+
+                run([&, j, b] {
+                    TaskResult& result = results[j * backends.size() + b];
+                    result.outputPath = jobs[j].outputDir + "/shader." + backend_name(backends[b]);
+                    try {
+                        BuildStats::Span span(stats, backend_name(backends[b]), "render", jobs[j].shaderPath);
+                        size_t substitutions = 0;
+                        std::string output = shaders[j].render(table, backends[b], &result.warnings, &substitutions);
+                        if (stats) {
+                            stats->add(std::string("substitutions.") + backend_name(backends[b]), substitutions);
+                            stats->add("output_bytes_written", output.size());
+                            stats->add("outputs_written");
+                        }
+                        if (writeHashes) {
+                            result.contentHash = hash64(output);
+                            result.contentSize = output.size();
+                        }
+                        if (blobs) {
+                            result.blob = store_output(result.outputPath, output);
+                        } else {
+                            result.written = io.write(result.outputPath, std::move(output));
+                        }
+                    } catch (...) {
+                        result.error = std::current_exception();
+                    }
+                });
+            }
+
+            run([&, j] {
+                try {
+                    std::string metadataPath = jobs[j].outputDir + "/macros.json";
+                    if (cache && cache->is_fresh(metadataPath, BuildCache::metadata_key(layoutKey))) return;
+
+                    BuildStats::Span span(stats, "macros.json", "metadata", jobs[j].outputDir);
+                    std::string metadata = table.metadata_json();
+                    if (stats) stats->add("output_bytes_written", metadata.size());
+                    if (blobs) {
+                        metadataBlobs[j] = store_output(metadataPath, metadata);
+                    } else {
+                        metadataWrites[j] = io.write(metadataPath, std::move(metadata));
+                    }
+                } catch (...) {
+                    metadataErrors[j] = std::current_exception();
+                }
+            });
+        });
+    }
+
+    if (pool) pool->wait();
+
+    // Outputs are recorded in the cache only once their write has finished.
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        if (loadErrors[j]) std::rethrow_exception(loadErrors[j]);
+        for (size_t b = 0; b < backends.size(); ++b) {
+            TaskResult& result = results[j * backends.size() + b];
+            for (const auto& warning : result.warnings) {
+                std::cerr << warning << "\n";
+            }
+            if (result.error) std::rethrow_exception(result.error);
+            if (result.written.valid()) {
+                if (result.written.get() == WriteStatus::Unchanged && stats) stats->add("outputs_unchanged");
+                if (cache) cache->record(result.outputPath, result.key);
+            }
+            if (stats && result.upToDate) stats->add("outputs_up_to_date");
+            if (blobs && !linkOutputs) {
+                std::cout << "Stored: " << result.outputPath << " as " << result.blob << "\n";
+            } else {
+                std::cout << (result.upToDate ? "Up to date: " : "Generated: ") << result.outputPath << "\n";
+            }
+        }
+        if (metadataErrors[j]) std::rethrow_exception(metadataErrors[j]);
+        if (metadataWrites[j].valid()) {
+            metadataWrites[j].get();
+            if (cache) cache->record(jobs[j].outputDir + "/macros.json", BuildCache::metadata_key(layoutKey));
+        }
+        if (writeHashes) write_hashes(jobs[j], &results[j * backends.size()], usages[j], metadataHash, metadataSize);
+    }
+
+    if (blobs) write_dedup_manifest(jobs, results, metadataBlobs);
+}
+
+std::vector<std::string> BuildDriver::output_paths(const ShaderJob& job) const {
+    std::vector<std::string> paths;
+    for (Backend backend : backends) {
+        paths.push_back(job.outputDir + "/shader." + backend_name(backend));
+    }
+    paths.push_back(job.outputDir + "/macros.json");
+    if (writeHashes) paths.push_back(job.outputDir + "/hashes.json");
+    return paths;
+}
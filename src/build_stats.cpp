@@ -0,0 +1,89 @@
+#include "build_stats.h"
+#include "output_file.h"
+#include <cstdio>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+BuildStats::BuildStats()
+    : origin(Clock::now()) {}
+
+BuildStats::Span::Span(BuildStats* stats, std::string name, const char* category, std::string detail)
+    : stats(stats), category(category) {
+    if (!stats) return;
+    this->name = std::move(name);
+    this->detail = std::move(detail);
+    start = Clock::now();
+}
+
+BuildStats::Span::~Span() {
+    if (stats) stats->record(std::move(name), category, std::move(detail), start, Clock::now());
+}
+
+void BuildStats::add(const std::string& counter, uint64_t value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters[counter] += value;
+}
+
+void BuildStats::record(std::string name, const char* category, std::string detail,
+                        Clock::time_point start, Clock::time_point end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned thread = threads.emplace(std::this_thread::get_id(), static_cast<unsigned>(threads.size())).first->second;
+    events.push_back(Event{std::move(name), category, std::move(detail),
+                           std::chrono::duration<double, std::micro>(start - origin).count(),
+                           std::chrono::duration<double, std::micro>(end - start).count(), thread});
+}
+
+void BuildStats::print(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    struct Total {
+        std::string label;
+        size_t count = 0;
+        double us = 0;
+    };
+    std::vector<Total> totals;
+    std::map<std::string, size_t> index;
+    for (const auto& event : events) {
+        std::string label = std::string(event.category) + " " + event.name;
+        auto it = index.emplace(label, totals.size()).first;
+        if (it->second == totals.size()) totals.push_back(Total{label});
+        totals[it->second].count += 1;
+        totals[it->second].us += event.durationUs;
+    }
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-40s %8s %12s\n", "span", "count", "total ms");
+    out << line;
+    for (const auto& total : totals) {
+        std::snprintf(line, sizeof(line), "%-40s %8zu %12.3f\n", total.label.c_str(), total.count, total.us / 1000);
+        out << line;
+    }
+    for (const auto& [name, value] : counters) {
+        std::snprintf(line, sizeof(line), "%-40s %21llu\n", name.c_str(), static_cast<unsigned long long>(value));
+        out << line;
+    }
+}
+
+void BuildStats::write_trace(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    nlohmann::json trace;
+    nlohmann::json& traceEvents = trace["traceEvents"] = nlohmann::json::array();
+    for (const auto& [id, thread] : threads) {
+        traceEvents.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", thread},
+                               {"args", {{"name", thread == 0 ? "main" : "worker " + std::to_string(thread)}}}});
+    }
+    for (const auto& event : events) {
+        nlohmann::json entry = {{"name", event.name}, {"cat", event.category}, {"ph", "X"},
+                                {"ts", event.startUs}, {"dur", event.durationUs},
+                                {"pid", 1}, {"tid", event.thread}};
+        if (!event.detail.empty()) entry["args"] = {{"path", event.detail}};
+        traceEvents.push_back(std::move(entry));
+    }
+    trace["displayTimeUnit"] = "ms";
+    trace["otherData"] = counters;
+
+    if (write_if_changed(path, trace.dump() + "\n") == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write trace to: " + path);
+    }
+}
@@ -0,0 +1,242 @@
+#include "cli_options.h"
+#include "parser.h"
+#include "thread_pool.h"
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static std::string batch_output_dir(const std::string& outputDir, const std::string& shaderPath) {
+    return (fs::path(outputDir) / fs::path(shaderPath).stem()).string();
+}
+
+static void check_unique_outputs(const std::vector<ShaderJob>& jobs) {
+    std::set<std::string> seen;
+    for (const auto& job : jobs) {
+        std::string dir = fs::path(job.outputDir).lexically_normal().string();
+        if (!seen.insert(dir).second) {
+            throw std::runtime_error("Several shaders write to the same output directory: " + job.outputDir);
+        }
+    }
+}
+
+static bool is_number(const std::string& value) {
+    if (value.empty()) return false;
+    for (char c : value) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+static unsigned parse_thread_count(const std::string& value) {
+    if (!is_number(value)) {
+        throw std::runtime_error("-j expects a thread count, got: " + value);
+    }
+    return static_cast<unsigned>(std::stoul(value));
+}
+
+CliOptions parse_cli_options(int argc, char** argv) {
+    CliOptions options;
+    std::vector<std::string> positional;
+    std::string manifestPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" || (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)) {
+            std::string count = arg.size() > 2 ? arg.substr(2) : "";
+            // "-j N" only takes N when it is a plain number, so "-j 2d.shader" keeps the shader.
+            if (count.empty() && i + 1 < argc && is_number(argv[i + 1])) {
+                count = argv[++i];
+            }
+            options.threadCount = count.empty() ? 0 : parse_thread_count(count);
+            if (options.threadCount == 0) options.threadCount = ThreadPool::default_thread_count();
+        } else if (arg == "--cache") {
+            if (i + 1 >= argc) throw std::runtime_error("--cache expects a directory");
+            options.cacheDir = argv[++i];
+        } else if (arg == "--depfile") {
+            if (i + 1 >= argc) throw std::runtime_error("--depfile expects a file path");
+            options.depfilePath = argv[++i];
+        } else if (arg == "-MD") {
+            options.depfilePerOutput = true;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--emit-table") {
+            if (i + 1 >= argc) throw std::runtime_error("--emit-table expects a file path");
+            options.tablePath = argv[++i];
+        } else if (arg == "--permute") {
+            if (i + 1 >= argc) throw std::runtime_error("--permute expects a comma-separated list of booleans");
+            std::istringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ',')) {
+                if (name.empty()) throw std::runtime_error("Empty boolean name in --permute");
+                options.permuteAxes.push_back(name);
+            }
+            if (options.permuteAxes.empty()) throw std::runtime_error("--permute expects at least one boolean");
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--backend") {
+            if (i + 1 >= argc) throw std::runtime_error("--backend expects a backend name");
+            options.backendName = argv[++i];
+            if (backend_from_name(options.backendName) == Backend::UNKNOWN) {
+                throw std::runtime_error("Unknown backend: " + options.backendName);
+            }
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) throw std::runtime_error("--trace expects a file path");
+            options.tracePath = argv[++i];
+        } else if (arg == "--dedup") {
+            if (i + 1 >= argc) throw std::runtime_error("--dedup expects a directory");
+            options.dedupDir = argv[++i];
+        } else if (arg == "--link") {
+            options.link = true;
+        } else if (arg == "--hashes") {
+            options.hashes = true;
+        } else if (arg == "--emit-cpp") {
+            if (i + 1 >= argc) throw std::runtime_error("--emit-cpp expects a path without extension");
+            options.cppPath = argv[++i];
+        } else if (arg == "--lazy-reads") {
+            options.lazyReads = true;
+        } else if (arg == "--manifest") {
+            if (i + 1 >= argc) throw std::runtime_error("--manifest expects a file path");
+            manifestPath = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            throw std::runtime_error("Unknown option: " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.empty()) throw std::runtime_error("Missing layout file");
+    options.layoutPath = positional[0];
+
+    if (!manifestPath.empty()) {
+        if (positional.size() > 2) throw std::runtime_error("Shader arguments cannot be combined with --manifest");
+        std::string outputDir = positional.size() == 2 ? positional[1] : "";
+        options.jobs = read_manifest(manifestPath, outputDir);
+    } else if (positional.size() == 3) {
+        options.jobs.push_back(ShaderJob{positional[1], positional[2]});
+    } else if (positional.size() > 3) {
+        const std::string& outputDir = positional.back();
+        for (size_t i = 1; i + 1 < positional.size(); ++i) {
+            options.jobs.push_back(ShaderJob{positional[i], batch_output_dir(outputDir, positional[i])});
+        }
+    } else if (positional.size() > 1 || options.tablePath.empty()) {
+        throw std::runtime_error("Missing shader or output directory");
+    }
+
+    for (const auto& job : options.jobs) {
+        if (job.shaderPath == "-" || job.outputDir == "-") options.stream = true;
+    }
+    if (options.stream) {
+        if (options.jobs.size() != 1) throw std::runtime_error("Streaming handles one shader at a time");
+        if (!options.cacheDir.empty() || options.watch || !options.permuteAxes.empty() ||
+            !options.depfilePath.empty() || options.depfilePerOutput) {
+            throw std::runtime_error("Streaming cannot be combined with --cache, --watch, --permute or depfiles");
+        }
+    } else if (!options.backendName.empty()) {
+        throw std::runtime_error("--backend is only used when streaming");
+    }
+
+    if (!options.permuteAxes.empty()) {
+        if (!options.cacheDir.empty() || options.watch || !options.tablePath.empty() ||
+            !options.depfilePath.empty() || options.depfilePerOutput) {
+            throw std::runtime_error("--permute cannot be combined with --cache, --watch, --emit-table or depfiles");
+        }
+        if (options.jobs.empty()) throw std::runtime_error("Missing shader or output directory");
+    }
+
+    if (!options.dedupDir.empty()) {
+        if (options.stream || !options.cacheDir.empty() || options.watch || !options.permuteAxes.empty()) {
+            throw std::runtime_error("--dedup cannot be combined with streaming, --cache, --watch or --permute");
+        }
+        if (!options.link && (!options.depfilePath.empty() || options.depfilePerOutput || options.hashes ||
+                              !options.cppPath.empty())) {
+            throw std::runtime_error("Depfiles, --hashes and --emit-cpp with --dedup need --link, so that the outputs exist");
+        }
+    } else if (options.link) {
+        throw std::runtime_error("--link is only used with --dedup");
+    }
+
+    if ((options.hashes || !options.cppPath.empty()) && (options.stream || !options.permuteAxes.empty())) {
+        throw std::runtime_error("--hashes and --emit-cpp cannot be combined with streaming or --permute");
+    }
+
+    if (options.watch && (options.stats || !options.tracePath.empty())) {
+        throw std::runtime_error("--stats and --trace cannot be combined with --watch");
+    }
+
+    check_unique_outputs(options.jobs);
+    return options;
+}
+
+std::vector<ShaderJob> read_manifest(const std::string& manifestPath, const std::string& defaultOutputDir) {
+    std::ifstream file(manifestPath);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open manifest: " + manifestPath);
+    }
+
+    std::vector<ShaderJob> jobs;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream fields(line);
+        std::string shaderPath, outputDir, extra;
+        if (!(fields >> shaderPath) || shaderPath[0] == '#') continue;
+
+        if (fields >> outputDir && fields >> extra) {
+            throw std::runtime_error("Too many fields in manifest at line " + std::to_string(lineNumber));
+        }
+        if (outputDir.empty()) {
+            if (defaultOutputDir.empty()) {
+                throw std::runtime_error("Manifest entry without output directory at line " +
+                                         std::to_string(lineNumber) + " and no default output directory given");
+            }
+            outputDir = batch_output_dir(defaultOutputDir, shaderPath);
+        }
+        jobs.push_back(ShaderJob{shaderPath, outputDir});
+    }
+    return jobs;
+}
+
+const char* cli_usage() {
+    return "Usage: slayoutc <layout.slayout> <input.shader> <output_dir>\n"
+           "       slayoutc <layout.slayout> <input.shader>... <output_dir>\n"
+           "       slayoutc <layout.slayout> --manifest <shaders.txt> [<output_dir>]\n"
+           "       slayoutc <layout.slayout> --emit-table <layout.sltable>\n"
+           "       slayoutc <layout.slayout> - - --backend <name>   (stdin to stdout)\n"
+           "\n"
+           "Options:\n"
+           "  -j [N]           Generate outputs on N threads (all cores when N is omitted or 0)\n"
+           "  --cache <dir>    Skip outputs whose layout, includes and shader are unchanged\n"
+           "  --depfile <path> Write a Make/Ninja depfile covering every output\n"
+           "  -MD              Write <output_dir>/shader.d next to each shader's outputs\n"
+           "  --watch          Keep running and regenerate outputs when inputs change (Linux)\n"
+           "  --emit-table <path>\n"
+           "                   Write the resolved macros as a binary table; pass a .sltable\n"
+           "                   in place of the layout to skip interpreting it\n"
+           "  --permute <a,b>  Generate every combination of the listed booleans, writing\n"
+           "                   deduplicated outputs and <output_dir>/permutations.json\n"
+           "  --stream         Expand the shader in fixed-size chunks instead of loading it whole;\n"
+           "                   implied when the shader or output directory is -\n"
+           "  --backend <name> Backend to stream; required when streaming from stdin or to\n"
+           "                   stdout with a layout that generates several backends\n"
+           "  --stats          Print the time spent in each phase and counters such as tokens,\n"
+           "                   macros, substitutions and bytes read and written to stderr\n"
+           "  --trace <path>   Write every phase and (shader, backend) job as a Chrome trace\n"
+           "                   (open in chrome://tracing or ui.perfetto.dev)\n"
+           "  --dedup <dir>    Store each distinct output once in <dir>, named by its hash, with\n"
+           "                   <dir>/outputs.json mapping every shader and backend to its file\n"
+           "  --link           With --dedup, also hard-link the usual output paths to the store\n"
+           "  --hashes         Write <output_dir>/hashes.json with the XXH64 hash, size and\n"
+           "                   expanded macros of every output\n"
+           "  --emit-cpp <path> Write <path>.h and <path>_data.h embedding every output as a\n"
+           "                   constexpr std::string_view, with a constexpr find_shader(name, backend)\n"
+           "  --lazy-reads     Do not read read_* files only backends the layout does not\n"
+           "                   generate would use; macros.json lists their paths instead\n";
+}
@@ -0,0 +1,195 @@
+#include "cpp_embed.h"
+#include "output_file.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+static std::string identifier(const std::string& text) {
+    std::string result;
+    for (char c : text) {
+        result += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    if (result.empty() || std::isdigit(static_cast<unsigned char>(result[0]))) result.insert(0, "_");
+    return result;
+}
+
+static const char* enumerator(Backend backend) {
+    switch (backend) {
+        case Backend::GLSL:  return "GLSL";
+        case Backend::HLSL:  return "HLSL";
+        case Backend::MSL:   return "MSL";
+        case Backend::SPIRV: return "SPIRV";
+        default:             return "UNKNOWN";
+    }
+}
+
+// Octal escapes are always three digits, so a digit that follows cannot extend
+// them, and "??" is broken up so it never reads as a trigraph.
+static std::string escape(std::string_view text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        char ch = text[i];
+        unsigned char c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '"':  escaped += "\\\""; break;
+            case '?':  escaped += i > 0 && text[i - 1] == '?' ? "\\?" : "?"; break;
+            case '\n': escaped += "\\n";  break;
+            case '\t': escaped += "\\t";  break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    char octal[5];
+                    std::snprintf(octal, sizeof(octal), "\\%03o", c);
+                    escaped += octal;
+                } else {
+                    escaped += ch;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+// MSVC rejects a string literal longer than 65535 bytes after concatenation, or
+// a piece longer than 16380 characters before it (C2026).
+static constexpr size_t MAX_LITERAL = 65535;
+static constexpr size_t MAX_LITERAL_PIECE = 16380;
+
+// One literal per line of text, concatenated by the compiler.
+static void write_literal(std::ostream& out, std::string_view text) {
+    size_t start = 0;
+    do {
+        size_t end = std::min({text.find('\n', start), text.size() - 1, start + MAX_LITERAL_PIECE - 1}) + 1;
+        if (start > 0) out << "\n";
+        out << "    \"" << escape(text.substr(start, end - start)) << "\"";
+        start = end;
+    } while (start < text.size());
+}
+
+// Character literals for text too long for one string literal, sixteen to a line.
+static void write_array(std::ostream& out, std::string_view text) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        out << (i == 0 ? "    " : i % 16 == 0 ? ",\n    " : ", ");
+        out << '\'' << (text[i] == '\'' ? "\\'" : escape(text.substr(i, 1))) << '\'';
+    }
+}
+
+static void write_file(const std::string& path, const std::string& contents) {
+    if (write_if_changed(path, contents) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write to output: " + path);
+    }
+}
+
+void write_cpp_embedding(const std::string& basePath, std::vector<EmbeddedShader> shaders) {
+    if (shaders.empty()) throw std::runtime_error("No shaders to embed in " + basePath);
+
+    std::stable_sort(shaders.begin(), shaders.end(), [](const EmbeddedShader& a, const EmbeddedShader& b) {
+        return a.name < b.name || (a.name == b.name && a.backend < b.backend);
+    });
+    for (size_t i = 1; i < shaders.size(); ++i) {
+        if (shaders[i].name == shaders[i - 1].name && shaders[i].backend == shaders[i - 1].backend) {
+            throw std::runtime_error("Several shaders are named " + shaders[i].name + "; --emit-cpp looks shaders up by name");
+        }
+    }
+
+    std::string stem = fs::path(basePath).filename().string();
+    std::string space = identifier(stem);
+
+    // Every text is an inline variable, so any number of translation units can
+    // include the headers and the linker keeps one copy.
+    std::ostringstream data;
+    data << "// Generated by slayoutc. Do not edit. Included by " << stem << ".h.\n"
+         << "#pragma once\n"
+         << "\n"
+         << "namespace " << space << " {\n"
+         << "\n"
+         << "namespace detail {\n";
+    std::vector<std::string> names(shaders.size());
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        if (i > 0 && shaders[i].name != shaders[i - 1].name) ++nameIndex;
+        names[i] = "shader" + std::to_string(nameIndex) + "_" + backend_name(shaders[i].backend);
+        data << "\n"
+             << "// " << escape(shaders[i].name) << " (" << backend_name(shaders[i].backend) << ")\n";
+        if (shaders[i].text.size() < MAX_LITERAL) {
+            data << "inline constexpr std::string_view " << names[i] << "{\n";
+            write_literal(data, shaders[i].text);
+            data << ", " << shaders[i].text.size() << "};\n";
+        } else {
+            data << "inline constexpr char " << names[i] << "_text[] = {\n";
+            write_array(data, shaders[i].text);
+            data << "\n};\n"
+                 << "inline constexpr std::string_view " << names[i] << "{" << names[i] << "_text, "
+                 << shaders[i].text.size() << "};\n";
+        }
+    }
+    data << "\n"
+         << "} // namespace detail\n"
+         << "\n"
+         << "// Every embedded shader, sorted by name and then backend.\n"
+         << "inline constexpr size_t shader_count = " << shaders.size() << ";\n"
+         << "inline constexpr Shader table[shader_count] = {\n";
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        data << "    {\"" << escape(shaders[i].name) << "\", Backend::" << enumerator(shaders[i].backend) << ", detail::"
+             << names[i] << "},\n";
+    }
+    data << "};\n"
+         << "\n"
+         << "} // namespace " << space << "\n";
+
+    std::ostringstream header;
+    header << "// Generated by slayoutc. Do not edit.\n"
+           << "#pragma once\n"
+           << "#include <cstddef>\n"
+           << "#include <string_view>\n"
+           << "\n"
+           << "namespace " << space << " {\n"
+           << "\n"
+           << "enum class Backend {\n";
+    for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+        header << "    " << enumerator(static_cast<Backend>(b)) << ",\n";
+    }
+    header << "};\n"
+           << "\n"
+           << "struct Shader {\n"
+           << "    std::string_view name;\n"
+           << "    Backend backend;\n"
+           << "    std::string_view text;\n"
+           << "};\n"
+           << "\n"
+           << "} // namespace " << space << "\n"
+           << "\n"
+           << "#include \"" << stem << "_data.h\"\n"
+           << "\n"
+           << "namespace " << space << " {\n"
+           << "\n"
+           << "// The expanded text, or an empty view if the shader was not generated for the\n"
+           << "// backend. Usable in constant expressions.\n"
+           << "constexpr std::string_view find_shader(std::string_view name, Backend backend) {\n"
+           << "    size_t first = 0;\n"
+           << "    size_t count = shader_count;\n"
+           << "    while (count > 0) {\n"
+           << "        size_t step = count / 2;\n"
+           << "        const Shader& shader = table[first + step];\n"
+           << "        if (shader.name < name || (shader.name == name && shader.backend < backend)) {\n"
+           << "            first += step + 1;\n"
+           << "            count -= step + 1;\n"
+           << "        } else {\n"
+           << "            count = step;\n"
+           << "        }\n"
+           << "    }\n"
+           << "    if (first == shader_count || table[first].name != name || table[first].backend != backend) return {};\n"
+           << "    return table[first].text;\n"
+           << "}\n"
+           << "\n"
+           << "} // namespace " << space << "\n";
+
+    write_file(basePath + "_data.h", data.str());
+    write_file(basePath + ".h", header.str());
+}
@@ -0,0 +1,40 @@
+#include "depfile.h"
+#include "output_file.h"
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+static std::string escape_path(const std::string& path) {
+    std::string escaped;
+    escaped.reserve(path.size());
+    for (char c : path) {
+        switch (c) {
+            case ' ':  escaped += "\\ "; break;
+            case '#':  escaped += "\\#"; break;
+            case '$':  escaped += "$$";  break;
+            default:   escaped += c;     break;
+        }
+    }
+    return escaped;
+}
+
+void write_depfile(const std::string& path, const std::vector<DepfileRule>& rules) {
+    std::ostringstream out;
+    for (const auto& rule : rules) {
+        for (size_t i = 0; i < rule.targets.size(); ++i) {
+            out << (i == 0 ? "" : " ") << escape_path(rule.targets[i]);
+        }
+        out << ":";
+
+        std::set<std::string> seen;
+        for (const auto& dependency : rule.dependencies) {
+            if (!seen.insert(dependency).second) continue;
+            out << " \\\n  " << escape_path(dependency);
+        }
+        out << "\n";
+    }
+
+    if (write_if_changed(path, out.str()) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write depfile: " + path);
+    }
+}
@@ -0,0 +1,36 @@
+#include "file_store.h"
+#include "hash.h"
+#include <stdexcept>
+
+// Smaller includes are read rather than mapped. A mapped file that an editor
+// truncates while it is in use faults on access instead of reading stale data.
+static constexpr size_t MIN_MAPPED_INCLUDE = 1 << 20;
+
+FileStore::FileStore(FileLoader loader)
+    : loader(std::move(loader)) {}
+
+std::string_view FileStore::load(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = files.find(path);
+    if (it == files.end()) {
+        Entry entry;
+        if (loader) {
+            entry.loaded = loader(path);
+        } else {
+            entry.mapped = MappedFile::open(path, MIN_MAPPED_INCLUDE);
+            if (!entry.mapped) {
+                throw std::runtime_error("Failed to read file: " + path);
+            }
+        }
+        it = files.emplace(path, std::move(entry)).first;
+
+        std::string_view contents = it->second.mapped ? it->second.mapped->contents() : it->second.loaded;
+        loadOrder.push_back(LoadedFile{path, hash64(contents), contents.size()});
+    }
+    return it->second.mapped ? it->second.mapped->contents() : std::string_view(it->second.loaded);
+}
+
+std::vector<LoadedFile> FileStore::loaded_files() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return loadOrder;
+}
@@ -0,0 +1,130 @@
+#include "file_watcher.h"
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+
+static std::string normalize(const std::string& path) {
+    return fs::absolute(path).lexically_normal().string();
+}
+
+FileWatcher::FileWatcher() {
+    fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Failed to initialize inotify: ") + std::strerror(errno));
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    if (fd >= 0) close(fd);
+}
+
+bool FileWatcher::supported() {
+    return true;
+}
+
+void FileWatcher::set_files(const std::vector<std::string>& paths) {
+    for (const auto& [wd, dir] : directories) {
+        inotify_rm_watch(fd, wd);
+    }
+    directories.clear();
+    files.clear();
+
+    std::set<std::string> dirs;
+    for (const auto& path : paths) {
+        std::string normalized = normalize(path);
+        files[normalized] = path;
+        dirs.insert(fs::path(normalized).parent_path().string());
+    }
+
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+    for (const auto& dir : dirs) {
+        int wd = inotify_add_watch(fd, dir.c_str(), mask);
+        // A missing directory holds nothing to watch yet; the caller passes its files again later.
+        if (wd < 0 && errno == ENOENT) continue;
+        if (wd < 0) {
+            throw std::runtime_error("Failed to watch directory " + dir + ": " + std::strerror(errno));
+        }
+        directories[wd] = dir;
+    }
+}
+
+bool FileWatcher::read_events(int timeoutMs, std::vector<std::string>& changed) {
+    pollfd pfd{fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0) {
+        if (errno == EINTR) return false;
+        throw std::runtime_error(std::string("Failed to wait for file changes: ") + std::strerror(errno));
+    }
+    if (ready == 0) return false;
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    bool any = false;
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            auto dir = directories.find(event->wd);
+            if (dir == directories.end() || event->len == 0) continue;
+
+            std::string path = (fs::path(dir->second) / event->name).string();
+            auto file = files.find(path);
+            if (file != files.end()) {
+                changed.push_back(file->second);
+                any = true;
+            }
+        }
+    }
+    return any;
+}
+
+std::vector<std::string> FileWatcher::wait(int settleMs) {
+    std::vector<std::string> changed;
+    while (changed.empty()) {
+        read_events(-1, changed);
+    }
+    // Editors often touch a file several times per save; let the burst settle.
+    while (read_events(settleMs, changed)) {}
+
+    std::set<std::string> unique(changed.begin(), changed.end());
+    return std::vector<std::string>(unique.begin(), unique.end());
+}
+
+#else
+
+FileWatcher::FileWatcher() {
+    throw std::runtime_error("Watch mode is only supported on Linux");
+}
+
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::supported() {
+    return false;
+}
+
+void FileWatcher::set_files(const std::vector<std::string>&) {}
+
+bool FileWatcher::read_events(int, std::vector<std::string>&) {
+    return false;
+}
+
+std::vector<std::string> FileWatcher::wait(int) {
+    return {};
+}
+
+#endif
@@ -1,170 +1,222 @@
 #include "interpreter.h"
-#include <fstream>
-#include <sstream>
-#include <iostream>
+#include "macro_table.h"
 #include <algorithm>
-#include <nlohmann/json.hpp>
+#include <iostream>
 
-void Interpreter::interpret(const std::vector<std::shared_ptr<Statement>>& statements) {
-    for (const auto& stmt : statements) {
-        execute(stmt);
-    }
+bool Macro::resolve(Backend backend, std::string_view& text) const {
+    const auto& value = backendValues[static_cast<size_t>(backend)];
+    if (value) {
+        text = *value;
+    } else if (!defaultValue.empty()) {
+        text = defaultValue;
+    } else if (lazy) {
+        text = macroName;
+    } else {
+        return false;
+    }
+    return true;
 }
 
-void Interpreter::execute(const std::shared_ptr<Statement>& stmt) {
-    if (auto def = std::dynamic_pointer_cast<MacroDefStatement>(stmt)) {
-        if (macros.count(def->macroName)) {
-            throw std::runtime_error("Duplicate macro name: " + def->macroName);
-        }
-        varToMacroName[def->varName] = def->macroName;
-        macros[def->macroName] = Macro{def->macroName};
-    }
-    else if (auto set = std::dynamic_pointer_cast<SetStatement>(stmt)) {
-        std::string macroName = varToMacroName.at(set->varName);
-        auto& macro = macros.at(macroName);
-        std::string backend = to_lower(set->backend);
-        std::string value;
-        if (set->isReadFromFile) {
-            if (set->parts.empty() || !set->isLiteral[0]) {
-                throw std::runtime_error("Expected literal path in read_*");
-            }
-            value = load_file(set->parts[0]);
-        } else {
-            for (size_t i = 0; i < set->parts.size(); ++i) {
-                if (set->isLiteral[i]) {
-                    value += set->parts[i];
-                } else {
-                    const std::string& varName = set->parts[i];
-                    if (!strings.count(varName)) {
-                        throw std::runtime_error("Undefined string variable: " + varName);
-                    }
-                    value += strings.at(varName);
-                }
-            }
-        }
+void Interpreter::interpret(const Program& program) {
+    interpret(program, program.root);
+    load_reads();
+}
 
-        macro.backendValues[backend] = value;
-    }
-    else if (auto setd = std::dynamic_pointer_cast<SetDefaultStatement>(stmt)) {
-        std::string macroName = varToMacroName.at(setd->varName);
-        auto& macro = macros.at(macroName);
+void Interpreter::interpret(const Program& program, IndexRange statements) {
+    execute_block(program, statements);
+}
 
-        std::string value;
+void Interpreter::override_boolean(std::string name, bool value) {
+    boolOverrides[std::move(name)] = value;
+}
+
+void Interpreter::set_quiet(bool value) {
+    quiet = value;
+}
 
-        if (setd->isReadFromFile) {
-            if (setd->parts.empty() || !setd->isLiteral[0]) {
-                throw std::runtime_error("Expected literal path in read_default");
+void Interpreter::set_lazy_reads(bool lazy) {
+    lazyReads = lazy;
+}
+
+void Interpreter::execute(const Program& program, const Statement& stmt) {
+    switch (stmt.kind) {
+        case StatementKind::MacroDef: {
+            std::string macroName(stmt.text);
+            if (macros.count(macroName)) {
+                throw std::runtime_error("Duplicate macro name: " + macroName);
             }
-            value = load_file(setd->parts[0]);
-        } else {
-            for (size_t i = 0; i < setd->parts.size(); ++i) {
-                if (setd->isLiteral[i]) {
-                    value += setd->parts[i];
-                } else {
-                    const std::string& varName = setd->parts[i];
-                    if (!strings.count(varName)) {
-                        throw std::runtime_error("Undefined string variable: " + varName);
-                    }
-                    value += strings.at(varName);
-                }
+            varToMacroName[std::string(stmt.name)] = macroName;
+            macros[macroName] = Macro{macroName, false, {}, {}, {}};
+            break;
+        }
+        case StatementKind::Set: {
+            auto& macro = macro_for(stmt.name);
+            Backend backend = backend_from_name(std::string(stmt.text));
+            if (backend == Backend::UNKNOWN) {
+                throw std::runtime_error("Unknown backend: " + std::string(stmt.text));
             }
+            assign_value(program, stmt, macro, static_cast<size_t>(backend), "read_*");
+            break;
         }
+        case StatementKind::SetDefault: {
+            assign_value(program, stmt, macro_for(stmt.name), BACKEND_COUNT, "read_default");
+            break;
+        }
+        case StatementKind::Lazy:
+            macro_for(stmt.name).lazy = true;
+            break;
+        case StatementKind::Boolean: {
+            bool value = stmt.flag;
+            auto forced = boolOverrides.find(stmt.name);
+            if (forced != boolOverrides.end()) value = forced->second;
 
-        macro.defaultValue = value;
-    }
-    else if (auto lazy = std::dynamic_pointer_cast<LazyStatement>(stmt)) {
-        std::string macroName = varToMacroName.at(lazy->varName);
-        macros.at(macroName).lazy = true;
+            auto it = bools.find(stmt.name);
+            if (it != bools.end()) it->second = value;
+            else bools.emplace(std::string(stmt.name), value);
+            break;
+        }
+        case StatementKind::If: {
+            auto it = bools.find(stmt.name);
+            if (it != bools.end() && it->second) {
+                execute_block(program, stmt.range);
+            }
+            break;
+        }
+        case StatementKind::GenerateAll:
+            requiredBackends = {Backend::GLSL, Backend::HLSL, Backend::MSL, Backend::SPIRV};
+            break;
+        case StatementKind::GenerateSelect:
+            for (uint32_t i = stmt.range.begin; i < stmt.range.end; ++i) {
+                Backend b = program.backends[i];
+                if (b != Backend::UNKNOWN) requiredBackends.insert(b);
+            }
+            break;
+        case StatementKind::Print:
+            if (quiet) break;
+            if (stmt.text == "list_backends") {
+                std::cout << "Supported backends: glsl, hlsl, msl, spirv\n";
+            } else {
+                std::cerr << "Unknown print expression: " << stmt.text << "\n";
+            }
+            break;
+        case StatementKind::String: {
+            auto it = strings.find(stmt.name);
+            if (it != strings.end()) it->second.assign(stmt.text.data(), stmt.text.size());
+            else strings.emplace(std::string(stmt.name), std::string(stmt.text));
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown statement type in interpreter");
     }
-    else if (auto b = std::dynamic_pointer_cast<BooleanDeclaration>(stmt)) {
-        bools[b->name] = b->value;
+}
+
+void Interpreter::execute_block(const Program& program, IndexRange body) {
+    for (uint32_t i = body.begin; i < body.end; ++i) {
+        execute(program, program.statements[i]);
     }
-    else if (auto iff = std::dynamic_pointer_cast<IfStatement>(stmt)) {
-        bool cond = bools.count(iff->conditionVar) && bools[iff->conditionVar];
-        if (cond) {
-            execute_block(iff->body);
-        }
+}
+
+Macro& Interpreter::macro_for(std::string_view varName) {
+    auto it = varToMacroName.find(varName);
+    if (it == varToMacroName.end()) {
+        throw std::runtime_error("Undefined macro variable: " + std::string(varName));
     }
-    else if (auto genAll = std::dynamic_pointer_cast<GenerateAllStatement>(stmt)) {
-        requiredBackends = {"glsl", "hlsl", "msl", "spirv"};
+    return macros.at(it->second);
+}
+
+// Value of a set_*/read_* call: the concatenated parts, or the contents of the named file.
+void Interpreter::assign_value(const Program& program, const Statement& stmt, Macro& macro,
+                               size_t slot, const char* readName) {
+    std::string_view& value = slot == BACKEND_COUNT ? macro.defaultValue : macro.backendValues[slot].emplace();
+    auto key = std::make_pair(macro.macroName, slot);
+    macro.unreadFiles.erase(slot);
+
+    if (!stmt.flag) {
+        value = values->copy(evaluate_parts(program, stmt));
+        pendingReads.erase(key);
+        return;
     }
-    else if (auto genSel = std::dynamic_pointer_cast<GenerateSelectStatement>(stmt)) {
-        for (auto b : genSel->backends) {
-            switch (b) {
-                case Backend::GLSL:  requiredBackends.insert("glsl");  break;
-                case Backend::HLSL:  requiredBackends.insert("hlsl");  break;
-                case Backend::MSL:   requiredBackends.insert("msl");   break;
-                case Backend::SPIRV: requiredBackends.insert("spirv"); break;
-                default: break;
-            }
-        }
+
+    const ValuePart* parts = program.parts.data() + stmt.range.begin;
+    if (stmt.range.size() == 0 || !parts[0].isLiteral) {
+        throw std::runtime_error(std::string("Expected literal path in ") + readName);
     }
-    else if (auto print = std::dynamic_pointer_cast<PrintStatement>(stmt)) {
-        if (print->expression == "list_backends") {
-            std::cout << "Supported backends: glsl, hlsl, msl, spirv\n";
+    value = {};
+    pendingReads[key] = PendingRead{readCount++, std::string(parts[0].text)};
+}
+
+std::string Interpreter::evaluate_parts(const Program& program, const Statement& stmt) const {
+    const ValuePart* parts = program.parts.data() + stmt.range.begin;
+    size_t count = stmt.range.size();
+
+    std::string value;
+    for (size_t i = 0; i < count; ++i) {
+        if (parts[i].isLiteral) {
+            value += parts[i].text;
         } else {
-            std::cerr << "Unknown print expression: " << print->expression << "\n";
+            auto it = strings.find(parts[i].text);
+            if (it == strings.end()) {
+                throw std::runtime_error("Undefined string variable: " + std::string(parts[i].text));
+            }
+            value += it->second;
         }
     }
-    else if (auto s = std::dynamic_pointer_cast<StringDeclaration>(stmt)) {
-        strings[s->name] = s->expression;
-    }
-    else {
-        throw std::runtime_error("Unknown statement type in interpreter");
-    }
+    return value;
 }
 
-void Interpreter::execute_block(const std::vector<std::shared_ptr<Statement>>& body) {
-    for (const auto& stmt : body) {
-        execute(stmt);
+void Interpreter::set_file_loader(FileLoader loader) {
+    files = std::make_shared<FileStore>(std::move(loader));
+}
+
+void Interpreter::set_stats(BuildStats* buildStats) {
+    stats = buildStats;
+}
+
+bool Interpreter::slot_used(const Macro& macro, size_t slot) const {
+    if (slot < BACKEND_COUNT) return requiredBackends.count(static_cast<Backend>(slot)) != 0;
+    for (Backend backend : requiredBackends) {
+        if (!macro.backendValues[static_cast<size_t>(backend)]) return true;
     }
+    return false;
 }
 
-std::string Interpreter::load_file(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to read file: " + path);
+void Interpreter::load_reads() {
+    // Load in statement order so dependency lists follow the layout.
+    std::vector<std::pair<const std::pair<std::string, size_t>*, const PendingRead*>> reads;
+    for (const auto& [key, read] : pendingReads) {
+        reads.emplace_back(&key, &read);
+    }
+    std::sort(reads.begin(), reads.end(), [](const auto& a, const auto& b) {
+        return a.second->order < b.second->order;
+    });
+
+    BuildStats::Span span(reads.empty() ? nullptr : stats, "read_includes");
+    for (const auto& [key, read] : reads) {
+        Macro& macro = macros.at(key->first);
+        size_t slot = key->second;
+        if (lazyReads && !slot_used(macro, slot)) {
+            macro.unreadFiles[slot] = read->path;
+            continue;
+        }
+        // The value points into the store's mapping; nothing is copied until the table is built.
+        std::string_view& value = slot == BACKEND_COUNT ? macro.defaultValue : *macro.backendValues[slot];
+        value = files->load(read->path);
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    pendingReads.clear();
 }
 
 const std::map<std::string, Macro>& Interpreter::get_macros() const {
     return macros;
 }
 
-const std::set<std::string>& Interpreter::get_required_backends() const {
+const std::set<Backend>& Interpreter::get_required_backends() const {
     return requiredBackends;
 }
 
-std::string Interpreter::to_lower(const std::string& s) const {
-    std::string result = s;
-    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) {
-        return std::tolower(c);
-    });
-    return result;
+std::vector<LoadedFile> Interpreter::get_loaded_files() const {
+    return files->loaded_files();
 }
 
-using json = nlohmann::json;
-
 void Interpreter::export_macro_metadata(const std::string& outputPath) const {
-    json j;
-    for (const auto& [macroName, macro] : macros) {
-        json macroJson;
-        macroJson["lazy"] = macro.lazy;
-        if (!macro.defaultValue.empty()) {
-            macroJson["default"] = macro.defaultValue;
-        }
-        for (const auto& [backend, code] : macro.backendValues) {
-            macroJson[backend] = code;
-        }
-        j[macroName] = macroJson;
-    }
-
-    std::ofstream out(outputPath);
-    if (!out) {
-        throw std::runtime_error("Failed to write macro metadata to: " + outputPath);
-    }
-    out << j.dump(4);
+    MacroTable::build(macros, requiredBackends).export_metadata(outputPath);
 }
\ No newline at end of file
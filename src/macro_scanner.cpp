@@ -0,0 +1,73 @@
+#include "macro_scanner.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SLAYOUT_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SLAYOUT_SCAN_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+#if defined(SLAYOUT_SCAN_AVX2) || defined(SLAYOUT_SCAN_SSE2)
+inline unsigned lowest_set_bit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+const char* find_scalar(const char* p, const char* end) {
+    for (; p != end; ++p) {
+        if (*p == '%') return p;
+    }
+    return end;
+}
+
+} // namespace
+
+const char* find_macro_marker(const char* begin, const char* end) {
+    const char* p = begin;
+
+#if defined(SLAYOUT_SCAN_AVX2)
+    const __m256i needle = _mm256_set1_epi8('%');
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) return p + lowest_set_bit(mask);
+        p += 32;
+    }
+#endif
+
+#if defined(SLAYOUT_SCAN_AVX2) || defined(SLAYOUT_SCAN_SSE2)
+    const __m128i needle16 = _mm_set1_epi8('%');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16)));
+        if (mask != 0) return p + lowest_set_bit(mask);
+        p += 16;
+    }
+#endif
+
+    return find_scalar(p, end);
+}
+
+const char* macro_scanner_isa() {
+#if defined(SLAYOUT_SCAN_AVX2)
+    return "avx2";
+#elif defined(SLAYOUT_SCAN_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
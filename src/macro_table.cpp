@@ -0,0 +1,327 @@
+#include "macro_table.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "output_file.h"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Layout of the image. Sizes are in bytes.
+//
+// Header (48):
+//   0  char[8]  magic "SLTABLE\0"
+//   8  u32      format version
+//   12 u32      macro count
+//   16 u32      bucket count (power of two)
+//   20 u32      bit mask of backends to generate, by Backend value
+//   24 u64      records offset
+//   32 u64      buckets offset
+//   40 u64      string pool offset
+//
+// Record (56): name ref, flags, default ref, then one value ref per backend.
+//   A ref is u32 offset into the image + u32 length; a value ref with length
+//   NO_VALUE means nothing is substituted. flags bit 0 is lazy, bits 8.. are
+//   the backends that were set explicitly, bits 16.. the slots (backends, then
+//   the default) whose read_* file was never loaded; their ref holds the path
+//   and substitutes nothing.
+//
+// Bucket (8): u32 low bits of hash64(name), u32 record index + 1 (0 = empty).
+constexpr char MAGIC[8] = {'S', 'L', 'T', 'A', 'B', 'L', 'E', '\0'};
+constexpr size_t HEADER_SIZE = 48;
+constexpr size_t REF_SIZE = 8;
+constexpr size_t RECORD_SIZE = REF_SIZE + 8 + REF_SIZE + BACKEND_COUNT * REF_SIZE;
+constexpr size_t BUCKET_SIZE = 8;
+constexpr uint32_t NO_VALUE = 0xFFFFFFFFu;
+constexpr uint32_t FLAG_LAZY = 1u;
+constexpr unsigned EXPLICIT_SHIFT = 8;
+constexpr unsigned UNREAD_SHIFT = 16;
+
+constexpr Backend BACKENDS[BACKEND_COUNT] = {Backend::GLSL, Backend::HLSL, Backend::MSL, Backend::SPIRV};
+
+inline uint32_t get32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline uint64_t get64(const unsigned char* p) {
+    return static_cast<uint64_t>(get32(p)) | static_cast<uint64_t>(get32(p + 4)) << 32;
+}
+
+void put32(std::string& out, size_t at, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out[at + i] = static_cast<char>(v >> (8 * i));
+}
+
+void put64(std::string& out, size_t at, uint64_t v) {
+    put32(out, at, static_cast<uint32_t>(v));
+    put32(out, at + 4, static_cast<uint32_t>(v >> 32));
+}
+
+// Appends strings to the pool once and hands back their offsets. Strings are
+// found again by hash and compared in the image, so each one is copied only once.
+class StringPool {
+public:
+    explicit StringPool(std::string& image) : image(image) {}
+
+    uint32_t add(std::string_view text) {
+        uint64_t hash = hash64(text);
+        auto [first, last] = offsets.equal_range(hash);
+        for (auto it = first; it != last; ++it) {
+            if (image.compare(it->second, text.size(), text) == 0) return it->second;
+        }
+        if (image.size() + text.size() > NO_VALUE) {
+            throw std::runtime_error("Macro table exceeds 4 GiB");
+        }
+        uint32_t offset = static_cast<uint32_t>(image.size());
+        image += text;
+        offsets.emplace(hash, offset);
+        return offset;
+    }
+
+private:
+    std::string& image;
+    std::unordered_multimap<uint64_t, uint32_t> offsets;
+};
+
+void put_ref(std::string& image, size_t at, uint32_t offset, uint32_t length) {
+    put32(image, at, offset);
+    put32(image, at + 4, length);
+}
+
+} // namespace
+
+MacroTable MacroTable::build(const std::map<std::string, Macro>& macros,
+                             const std::set<Backend>& requiredBackends) {
+    uint32_t count = static_cast<uint32_t>(macros.size());
+    uint32_t buckets = 1;
+    while (buckets < count * 2u) buckets <<= 1;
+
+    const size_t recordsOffset = HEADER_SIZE;
+    const size_t bucketsOffset = recordsOffset + size_t(count) * RECORD_SIZE;
+    const size_t poolOffset = bucketsOffset + size_t(buckets) * BUCKET_SIZE;
+
+    std::string image(poolOffset, '\0');
+    std::memcpy(&image[0], MAGIC, sizeof(MAGIC));
+    put32(image, 8, FORMAT_VERSION);
+    put32(image, 12, count);
+    put32(image, 16, buckets);
+
+    uint32_t backendMask = 0;
+    for (Backend backend : requiredBackends) {
+        backendMask |= 1u << static_cast<unsigned>(backend);
+    }
+    put32(image, 20, backendMask);
+    put64(image, 24, recordsOffset);
+    put64(image, 32, bucketsOffset);
+    put64(image, 40, poolOffset);
+
+    StringPool pool(image);
+    uint32_t index = 0;
+    for (const auto& [macroName, macro] : macros) {
+        size_t at = recordsOffset + size_t(index) * RECORD_SIZE;
+        uint32_t flags = macro.lazy ? FLAG_LAZY : 0;
+        auto add_ref = [&](size_t ref, std::string_view text) {
+            put_ref(image, ref, pool.add(text), static_cast<uint32_t>(text.size()));
+        };
+
+        add_ref(at, macroName);
+        auto unreadDefault = macro.unreadFiles.find(BACKEND_COUNT);
+        if (unreadDefault != macro.unreadFiles.end()) {
+            flags |= 1u << (UNREAD_SHIFT + BACKEND_COUNT);
+            add_ref(at + 16, unreadDefault->second);
+        } else {
+            add_ref(at + 16, macro.defaultValue);
+        }
+
+        for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+            size_t ref = at + 24 + b * REF_SIZE;
+            if (macro.backendValues[b]) flags |= 1u << (EXPLICIT_SHIFT + b);
+            std::string_view value;
+            auto unread = macro.unreadFiles.find(b);
+            if (unread != macro.unreadFiles.end()) {
+                flags |= 1u << (UNREAD_SHIFT + b);
+                add_ref(ref, unread->second);
+            } else if (macro.resolve(BACKENDS[b], value)) {
+                add_ref(ref, value);
+            } else {
+                put_ref(image, ref, 0, NO_VALUE);
+            }
+        }
+        put32(image, at + 8, flags);
+
+        // Linear probing; the table is at most half full.
+        uint64_t hash = hash64(macroName);
+        uint32_t slot = static_cast<uint32_t>(hash) & (buckets - 1);
+        while (get32(reinterpret_cast<const unsigned char*>(image.data()) + bucketsOffset + slot * BUCKET_SIZE + 4) != 0) {
+            slot = (slot + 1) & (buckets - 1);
+        }
+        put32(image, bucketsOffset + slot * BUCKET_SIZE, static_cast<uint32_t>(hash));
+        put32(image, bucketsOffset + slot * BUCKET_SIZE + 4, index + 1);
+        ++index;
+    }
+
+    return from_image(std::move(image));
+}
+
+MacroTable MacroTable::from_image(std::string image) {
+    auto owned = std::make_shared<std::string>(std::move(image));
+    const auto* bytes = reinterpret_cast<const unsigned char*>(owned->data());
+    size_t size = owned->size();
+    return attach(std::shared_ptr<const void>(owned, owned.get()), bytes, size);
+}
+
+MacroTable MacroTable::open(const std::string& path) {
+    std::shared_ptr<const MappedFile> file = MappedFile::open(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open macro table: " + path);
+    }
+    std::string_view bytes = file->contents();
+    return attach(file, reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+}
+
+MacroTable MacroTable::attach(std::shared_ptr<const void> storage, const unsigned char* data, size_t length) {
+    if (length < HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a macro table");
+    }
+    if (get32(data + 8) != FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported macro table version " + std::to_string(get32(data + 8)));
+    }
+
+    MacroTable table;
+    table.storage = std::move(storage);
+    table.data = data;
+    table.length = length;
+    table.macroCount = get32(data + 12);
+    uint32_t buckets = get32(data + 16);
+    table.bucketMask = buckets - 1;
+    table.backendMask = get32(data + 20);
+    table.recordsOffset = get64(data + 24);
+    table.bucketsOffset = get64(data + 32);
+
+    // build() keeps the buckets at most half full; a fuller table is not one it wrote.
+    bool valid = buckets != 0 && (buckets & (buckets - 1)) == 0 &&
+                 uint64_t(buckets) >= 2 * uint64_t(table.macroCount) &&
+                 table.recordsOffset <= length &&
+                 uint64_t(table.macroCount) * RECORD_SIZE <= length - table.recordsOffset &&
+                 table.bucketsOffset <= length &&
+                 uint64_t(buckets) * BUCKET_SIZE <= length - table.bucketsOffset;
+
+    // Every string reference must stay inside the image.
+    for (uint32_t i = 0; valid && i < table.macroCount; ++i) {
+        const unsigned char* rec = table.record(i);
+        for (size_t ref = 0; ref < RECORD_SIZE; ref += REF_SIZE) {
+            if (ref == 8) continue; // flags
+            uint64_t offset = get32(rec + ref);
+            uint64_t size = get32(rec + ref + 4);
+            if (size != NO_VALUE && offset + size > length) valid = false;
+        }
+    }
+    for (uint32_t i = 0; valid && i < buckets; ++i) {
+        if (get32(data + table.bucketsOffset + i * BUCKET_SIZE + 4) > table.macroCount) valid = false;
+    }
+
+    if (!valid) {
+        throw std::runtime_error("Corrupt macro table");
+    }
+    return table;
+}
+
+void MacroTable::write(const std::string& path) const {
+    if (write_if_changed(path, image()) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write macro table: " + path);
+    }
+}
+
+uint32_t MacroTable::find(std::string_view name) const {
+    if (macroCount == 0) return NOT_FOUND;
+    uint64_t hash = hash64(name);
+    uint32_t slot = static_cast<uint32_t>(hash) & bucketMask;
+    // Bounded even if every bucket of a damaged image is taken.
+    for (uint64_t probe = 0; probe <= bucketMask; ++probe) {
+        const unsigned char* bucket = data + bucketsOffset + slot * BUCKET_SIZE;
+        uint32_t entry = get32(bucket + 4);
+        if (entry == 0) return NOT_FOUND;
+        if (get32(bucket) == static_cast<uint32_t>(hash) && string_at(record(entry - 1)) == name) {
+            return entry - 1;
+        }
+        slot = (slot + 1) & bucketMask;
+    }
+    return NOT_FOUND;
+}
+
+bool MacroTable::value(uint32_t index, Backend backend, std::string_view& text) const {
+    const unsigned char* rec = record(index);
+    const unsigned char* ref = rec + 24 + static_cast<size_t>(backend) * REF_SIZE;
+    if (get32(ref + 4) == NO_VALUE) return false;
+    if (get32(rec + 8) & (1u << (UNREAD_SHIFT + static_cast<unsigned>(backend)))) return false;
+    text = string_at(ref);
+    return true;
+}
+
+size_t MacroTable::size() const {
+    return macroCount;
+}
+
+std::string_view MacroTable::name(uint32_t index) const {
+    return string_at(record(index));
+}
+
+std::vector<Backend> MacroTable::required_backends() const {
+    std::vector<Backend> backends;
+    for (Backend backend : BACKENDS) {
+        if (backendMask & (1u << static_cast<unsigned>(backend))) backends.push_back(backend);
+    }
+    return backends;
+}
+
+std::string_view MacroTable::image() const {
+    return std::string_view(reinterpret_cast<const char*>(data), length);
+}
+
+const unsigned char* MacroTable::record(uint32_t index) const {
+    return data + recordsOffset + size_t(index) * RECORD_SIZE;
+}
+
+std::string_view MacroTable::string_at(const unsigned char* ref) const {
+    return std::string_view(reinterpret_cast<const char*>(data) + get32(ref), get32(ref + 4));
+}
+
+using json = nlohmann::json;
+
+std::string MacroTable::metadata_json() const {
+    json j;
+    for (uint32_t i = 0; i < macroCount; ++i) {
+        const unsigned char* rec = record(i);
+        uint32_t flags = get32(rec + 8);
+
+        json macroJson;
+        json files; // read_* paths that were never loaded
+        macroJson["lazy"] = (flags & FLAG_LAZY) != 0;
+        std::string_view defaultValue = string_at(rec + 16);
+        if (flags & (1u << (UNREAD_SHIFT + BACKEND_COUNT))) {
+            files["default"] = std::string(defaultValue);
+        } else if (!defaultValue.empty()) {
+            macroJson["default"] = std::string(defaultValue);
+        }
+        for (size_t b = 0; b < BACKEND_COUNT; ++b) {
+            if (!(flags & (1u << (EXPLICIT_SHIFT + b)))) continue;
+            std::string value(string_at(rec + 24 + b * REF_SIZE));
+            if (flags & (1u << (UNREAD_SHIFT + b))) {
+                files[backend_name(BACKENDS[b])] = std::move(value);
+            } else {
+                macroJson[backend_name(BACKENDS[b])] = std::move(value);
+            }
+        }
+        if (!files.empty()) macroJson["files"] = std::move(files);
+        j[std::string(name(i))] = macroJson;
+    }
+    return j.dump(4);
+}
+
+void MacroTable::export_metadata(const std::string& outputPath) const {
+    if (write_if_changed(outputPath, metadata_json()) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write macro metadata to: " + outputPath);
+    }
+}
@@ -1,42 +1,328 @@
-#include "tokenizer.h"
-#include "parser.h"
-#include "interpreter.h"
+#include "slayout.h"
+#include "cli_options.h"
+#include "build_driver.h"
+#include "build_cache.h"
+#include "build_stats.h"
+#include "cpp_embed.h"
+#include "depfile.h"
+#include "file_watcher.h"
+#include "mapped_file.h"
+#include "output_file.h"
+#include "permutation_sweep.h"
 #include "shader_processor.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <set>
 
+static bool is_table_path(const std::string& path) {
+    return std::filesystem::path(path).extension() == ".sltable";
+}
 
-int main(int argc, char** argv) {
-    if (argc < 4) {
-        std::cerr << "Usage: slayoutc <layout.slayout> <input.shader> <output_dir>\n";
-        return 1;
+static std::string read_layout_source(const std::string& path) {
+    std::ifstream file(path);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void run_permutations(const CliOptions& options) {
+    if (is_table_path(options.layoutPath)) {
+        throw std::runtime_error("--permute needs the layout source, not a precompiled table");
+    }
+    PermutationSweep sweep(read_layout_source(options.layoutPath), options.permuteAxes, nullptr, options.lazyReads);
+    sweep.build(options.jobs, options.threadCount);
+}
+
+// The layout is tokenized, parsed and interpreted once for the whole batch;
+// a precompiled .sltable is mapped as is.
+static std::unique_ptr<Layout> load_layout(const std::string& path, bool lazyReads, BuildStats* stats = nullptr,
+                                           FileLoader loader = nullptr) {
+    if (is_table_path(path)) {
+        BuildStats::Span span(stats, "open_table");
+        return std::make_unique<Layout>(Layout::open_table(path));
+    }
+    std::string source;
+    {
+        BuildStats::Span span(stats, "read_layout");
+        source = read_layout_source(path);
     }
+    return std::make_unique<Layout>(Layout::compile(source, std::move(loader), stats, lazyReads));
+}
 
-    std::string slayoutFile = argv[1];
-    std::string shaderFile = argv[2];
-    std::string outputDir = argv[3];
+// Each job's outputs depend on the layout, every read_* include and its shader.
+static DepfileRule dependency_rule(const CliOptions& options, const Layout& layout,
+                                   const BuildDriver& driver, const ShaderJob& job) {
+    DepfileRule rule;
+    rule.targets = driver.output_paths(job);
+    rule.dependencies.push_back(options.layoutPath);
+    for (const auto& file : layout.loaded_files()) {
+        rule.dependencies.push_back(file.path);
+    }
+    rule.dependencies.push_back(job.shaderPath);
+    return rule;
+}
+
+static bool writes_to_stdout(const CliOptions& options) {
+    return options.stream && options.jobs[0].outputDir == "-";
+}
 
-    std::ifstream file(slayoutFile);
-    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+static void emit_table(const CliOptions& options, const Layout& layout, BuildStats* stats = nullptr) {
+    if (options.tablePath.empty()) return;
+    BuildStats::Span span(stats, "emit_table");
+    layout.write_table(options.tablePath);
+    (writes_to_stdout(options) ? std::cerr : std::cout) << "Generated: " << options.tablePath << "\n";
+}
 
-    Tokenizer tokenizer(source);
-    auto tokens = tokenizer.tokenize();
+// Expands one shader without loading it whole. stdin can only be read once and
+// stdout holds one output, so "-" on either side allows a single backend.
+static void run_stream(const CliOptions& options, const Layout& layout, BuildStats* stats) {
+    const ShaderJob& job = options.jobs[0];
+    const bool toStdout = writes_to_stdout(options);
 
-    Parser parser(tokens);
-    auto statements = parser.parse();
+    std::vector<Backend> backends = layout.backends();
+    if (!options.backendName.empty()) {
+        // read_* files of backends the layout does not generate are never loaded.
+        Backend backend = backend_from_name(options.backendName);
+        if (std::find(backends.begin(), backends.end(), backend) == backends.end()) {
+            throw std::runtime_error("The layout does not generate backend " + options.backendName);
+        }
+        backends = {backend};
+    }
+    if (backends.size() > 1 && (job.shaderPath == "-" || toStdout)) {
+        throw std::runtime_error("Streaming from stdin or to stdout needs --backend when the layout generates several backends");
+    }
+    if (!toStdout) {
+        std::filesystem::create_directories(job.outputDir);
+    }
 
-    Interpreter interpreter;
-    interpreter.interpret(statements);
+    for (Backend backend : backends) {
+        BuildStats::Span span(stats, backend_name(backend), "stream", job.shaderPath);
+        std::ifstream file;
+        if (job.shaderPath != "-") {
+            file.open(job.shaderPath, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open shader file: " + job.shaderPath);
+            }
+        }
+        std::istream& in = job.shaderPath == "-" ? std::cin : file;
 
-    const auto& macros = interpreter.get_macros();
-    const auto& backends = interpreter.get_required_backends();
+        if (toStdout) {
+            ShaderProcessor::stream_shader(in, std::cout, layout.table(), backend);
+            std::cout.flush();
+            continue;
+        }
 
-    for (const auto& backend : backends) {
-        std::string outputPath = outputDir + "/shader." + backend;
-        ShaderProcessor::process_shader(shaderFile, outputPath, macros, backend);
+        std::string outputPath = job.outputDir + "/shader." + backend_name(backend);
+        std::string temporary = temporary_path(outputPath);
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to write to output: " + outputPath);
+            }
+            ShaderProcessor::stream_shader(in, out, layout.table(), backend);
+        }
+        if (commit_temporary(temporary, outputPath) == WriteStatus::Failed) {
+            throw std::runtime_error("Failed to write to output: " + outputPath);
+        }
         std::cout << "Generated: " << outputPath << "\n";
     }
-    interpreter.export_macro_metadata(outputDir + "/macros.json");
+
+    if (!toStdout) {
+        BuildStats::Span span(stats, "macros.json", "metadata", job.outputDir);
+        layout.table().export_metadata(job.outputDir + "/macros.json");
+    }
+}
+
+// Embeds the outputs of every job, not only the ones just rebuilt; the others are
+// still on disk from an earlier build.
+static void emit_cpp(const CliOptions& options, const Layout& layout) {
+    std::vector<EmbeddedShader> shaders;
+    for (const auto& job : options.jobs) {
+        std::string name = std::filesystem::path(job.shaderPath).stem().string();
+        for (Backend backend : layout.table().required_backends()) {
+            std::string path = job.outputDir + "/shader." + backend_name(backend);
+            auto file = MappedFile::open(path);
+            if (!file) throw std::runtime_error("Failed to read output: " + path);
+            shaders.push_back(EmbeddedShader{name, backend, std::string(file->contents())});
+        }
+    }
+    std::filesystem::path parent = std::filesystem::path(options.cppPath).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent);
+    write_cpp_embedding(options.cppPath, std::move(shaders));
+}
+
+static void run_build(const CliOptions& options, const Layout& layout, const std::vector<ShaderJob>& jobs,
+                      BuildStats* stats = nullptr) {
+    if (jobs.empty()) return;
+
+    BuildDriver driver(layout.table(), options.threadCount);
+    if (stats) driver.enable_stats(*stats);
+    if (options.hashes) driver.enable_hashes();
+    std::unique_ptr<BlobStore> blobs;
+    if (!options.dedupDir.empty()) {
+        blobs = std::make_unique<BlobStore>(options.dedupDir);
+        driver.enable_dedup(*blobs, options.link);
+    }
+    if (options.cacheDir.empty()) {
+        BuildStats::Span span(stats, "build");
+        driver.build(jobs);
+    } else {
+        std::unique_ptr<BuildCache> cache;
+        {
+            BuildStats::Span span(stats, "load_cache");
+            cache = std::make_unique<BuildCache>(options.cacheDir);
+        }
+        driver.enable_cache(*cache, BuildCache::layout_key(layout.table()));
+        try {
+            BuildStats::Span span(stats, "build");
+            driver.build(jobs);
+        } catch (...) {
+            // Outputs written before the failure are still valid.
+            cache->save();
+            throw;
+        }
+        BuildStats::Span span(stats, "save_cache");
+        cache->save();
+    }
+
+    BuildStats::Span span(options.depfilePath.empty() && !options.depfilePerOutput ? nullptr : stats, "depfiles");
+    if (!options.depfilePath.empty()) {
+        std::vector<DepfileRule> rules;
+        for (const auto& job : options.jobs) {
+            rules.push_back(dependency_rule(options, layout, driver, job));
+        }
+        write_depfile(options.depfilePath, rules);
+    }
+    if (options.depfilePerOutput) {
+        for (const auto& job : jobs) {
+            write_depfile(job.outputDir + "/shader.d", {dependency_rule(options, layout, driver, job)});
+        }
+    }
+
+    if (!options.cppPath.empty()) {
+        BuildStats::Span span(stats, "emit_cpp");
+        emit_cpp(options, layout);
+    }
+}
+
+static std::vector<std::string> watched_files(const CliOptions& options, const std::set<std::string>& includes) {
+    std::vector<std::string> paths{options.layoutPath};
+    paths.insert(paths.end(), includes.begin(), includes.end());
+    for (const auto& job : options.jobs) {
+        paths.push_back(job.shaderPath);
+    }
+    return paths;
+}
+
+// Keeps the interpreted layout in memory and regenerates outputs as inputs change.
+// A change to the layout or a read_* include re-interprets the layout and rebuilds
+// everything; a change to a shader only rebuilds that shader's outputs.
+static int watch(const CliOptions& options) {
+    FileWatcher watcher;
+    std::unique_ptr<Layout> layout;
+    // read_* paths of the last load. A failed load keeps them and adds every path
+    // it tried, so fixing a missing or broken include triggers the next reload.
+    std::set<std::string> includes;
+
+    auto reload = [&]() {
+        std::set<std::string> attempted;
+        // Includes are read, not mapped: an editor may truncate one mid-load.
+        auto loader = [&attempted](const std::string& path) {
+            attempted.insert(path);
+            auto file = MappedFile::open(path, SIZE_MAX);
+            if (!file) throw std::runtime_error("Failed to read file: " + path);
+            return std::string(file->contents());
+        };
+        try {
+            layout = load_layout(options.layoutPath, options.lazyReads, nullptr, loader);
+            includes.clear();
+            for (const auto& file : layout->loaded_files()) {
+                includes.insert(file.path);
+            }
+            emit_table(options, *layout);
+            run_build(options, *layout, options.jobs);
+        } catch (const std::exception& e) {
+            // Keep watching: the next save will most likely fix it.
+            includes.insert(attempted.begin(), attempted.end());
+            layout.reset();
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+        watcher.set_files(watched_files(options, includes));
+    };
+
+    reload();
+    std::cout << "Watching for changes...\n";
+
+    while (true) {
+        std::cout.flush();
+        std::vector<std::string> changed = watcher.wait();
+        std::set<std::string> changedSet(changed.begin(), changed.end());
+
+        bool layoutChanged = !layout || changedSet.count(options.layoutPath);
+        for (const auto& path : includes) {
+            layoutChanged = layoutChanged || changedSet.count(path);
+        }
+
+        if (layoutChanged) {
+            std::cout << "Layout changed, reloading " << options.layoutPath << "\n";
+            reload();
+            continue;
+        }
+
+        std::vector<ShaderJob> jobs;
+        for (const auto& job : options.jobs) {
+            if (changedSet.count(job.shaderPath)) jobs.push_back(job);
+        }
+        try {
+            run_build(options, *layout, jobs);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    try {
+        options = parse_cli_options(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n" << cli_usage();
+        return 1;
+    }
+
+    std::unique_ptr<BuildStats> stats;
+    if (options.stats || !options.tracePath.empty()) {
+        stats = std::make_unique<BuildStats>();
+    }
+
+    try {
+        if (options.watch) {
+            return watch(options);
+        }
+        if (!options.permuteAxes.empty()) {
+            BuildStats::Span span(stats.get(), "permute");
+            run_permutations(options);
+        } else {
+            auto layout = load_layout(options.layoutPath, options.lazyReads, stats.get());
+            emit_table(options, *layout, stats.get());
+            if (options.stream) {
+                run_stream(options, *layout, stats.get());
+            } else {
+                run_build(options, *layout, options.jobs, stats.get());
+            }
+        }
+
+        if (options.stats) {
+            stats->print(std::cerr);
+        }
+        if (!options.tracePath.empty()) {
+            stats->write_trace(options.tracePath);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,75 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SLAYOUT_HAVE_MMAP 1
+#endif
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& path, size_t minMapSize) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef SLAYOUT_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    size_t size = regular ? static_cast<size_t>(st.st_size) : 0;
+    if (regular && size > 0 && size >= minMapSize) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::close(fd);
+            file->data = static_cast<const char*>(mapping);
+            file->size = size;
+            file->mapped = true;
+            return file;
+        }
+    } else if (regular) {
+        // One read() into a buffer of the right size; a file that shrank meanwhile just reads shorter.
+        file->buffer.resize(size);
+        size_t done = 0;
+        while (done < file->buffer.size()) {
+            ssize_t n = ::read(fd, &file->buffer[done], file->buffer.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                ::close(fd);
+                return nullptr;
+            }
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        file->buffer.resize(done);
+        file->data = file->buffer.data();
+        file->size = file->buffer.size();
+        return file;
+    }
+    ::close(fd);
+#endif
+
+    // Pipes and platforms without mmap.
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return nullptr;
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    file->buffer = buffer.str();
+    file->data = file->buffer.data();
+    file->size = file->buffer.size();
+    return file;
+}
+
+MappedFile::~MappedFile() {
+#ifdef SLAYOUT_HAVE_MMAP
+    if (mapped) munmap(const_cast<char*>(data), size);
+#endif
+}
+
+std::string_view MappedFile::contents() const {
+    return std::string_view(data, size);
+}
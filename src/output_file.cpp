@@ -0,0 +1,86 @@
+#include "output_file.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+bool file_has_contents(const std::string& path, std::string_view contents) {
+    std::error_code ec;
+    if (fs::file_size(path, ec) != contents.size() || ec) return false;
+
+    auto existing = MappedFile::open(path);
+    return existing && existing->contents() == contents;
+}
+
+std::string temporary_path(const std::string& path) {
+    // Unique across threads and across processes writing the same output.
+    static const uint64_t processSeed = std::random_device{}() * 0x9E3779B97F4A7C15ull;
+    static std::atomic<uint64_t> counter{0};
+    return path + ".tmp" + hash_to_hex(processSeed + counter.fetch_add(1));
+}
+
+WriteStatus write_if_changed(const std::string& path, std::string_view contents) {
+    if (file_has_contents(path, contents)) return WriteStatus::Unchanged;
+
+    std::string temporary = temporary_path(path);
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return WriteStatus::Failed;
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!out.flush()) {
+            out.close();
+            std::error_code ec;
+            fs::remove(temporary, ec);
+            return WriteStatus::Failed;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        fs::remove(temporary, ec);
+        return WriteStatus::Failed;
+    }
+    return WriteStatus::Written;
+}
+
+WriteStatus commit_temporary(const std::string& temporaryPath, const std::string& path) {
+    std::error_code ec;
+    auto written = MappedFile::open(temporaryPath);
+    if (!written) {
+        fs::remove(temporaryPath, ec);
+        return WriteStatus::Failed;
+    }
+    bool unchanged = file_has_contents(path, written->contents());
+    written.reset();
+
+    if (unchanged) {
+        fs::remove(temporaryPath, ec);
+        return WriteStatus::Unchanged;
+    }
+    fs::rename(temporaryPath, path, ec);
+    if (ec) {
+        fs::remove(temporaryPath, ec);
+        return WriteStatus::Failed;
+    }
+    return WriteStatus::Written;
+}
+
+WriteStatus link_or_copy(const std::string& target, const std::string& path, std::string_view contents) {
+    std::error_code ec;
+    if (fs::equivalent(target, path, ec)) return WriteStatus::Unchanged;
+
+    std::string temporary = temporary_path(path);
+    fs::create_hard_link(target, temporary, ec);
+    if (ec) return write_if_changed(path, contents);
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        fs::remove(temporary, ec);
+        return WriteStatus::Failed;
+    }
+    return WriteStatus::Written;
+}
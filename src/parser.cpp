@@ -1,6 +1,7 @@
 #include "parser.h"
 #include <stdexcept>
 #include <iostream>
+#include <cctype>
 
 Parser::Parser(const std::vector<Token>& tokens)
     : tokens(tokens), current(0) {}
@@ -36,17 +37,46 @@ void Parser::consume(TokenType type, const std::string& errorMessage) {
     }
 }
 
-std::vector<std::shared_ptr<Statement>> Parser::parse() {
-    std::vector<std::shared_ptr<Statement>> statements;
+static Statement make_statement(StatementKind kind) {
+    Statement stmt;
+    stmt.kind = kind;
+    return stmt;
+}
+
+Program Parser::parse() {
+    program = Program{};
+    statementList.clear();
+    partList.clear();
+    backendList.clear();
+
+    std::vector<Statement> statements;
     while (!check(TokenType::EndOfFile)) {
         statements.push_back(parse_statement());
     }
-    return statements;
+    program.root = append_block(statements);
+
+    program.statements = program.arena.copy(statementList);
+    program.parts = program.arena.copy(partList);
+    program.backends = program.arena.copy(backendList);
+    return std::move(program);
 }
 
-std::shared_ptr<Statement> Parser::parse_statement() {
+std::string_view Parser::intern(const Token& token) {
+    if (!token.hasEscapes) return program.arena.copy(token.value);
+    return program.arena.copy(token_text(token));
+}
+
+IndexRange Parser::append_block(const std::vector<Statement>& block) {
+    IndexRange range;
+    range.begin = static_cast<uint32_t>(statementList.size());
+    statementList.insert(statementList.end(), block.begin(), block.end());
+    range.end = static_cast<uint32_t>(statementList.size());
+    return range;
+}
+
+Statement Parser::parse_statement() {
     if (match(TokenType::Keyword)) {
-        std::string keyword = previous().value;
+        std::string_view keyword = previous().value;
         if (keyword == "macrodef") return parse_macro_def();
         if (keyword == "boolean") return parse_boolean();
         if (keyword == "if") return parse_if();
@@ -60,48 +90,44 @@ std::shared_ptr<Statement> Parser::parse_statement() {
     throw std::runtime_error("Unknown statement at line " + std::to_string(peek().line));
 }
 
-std::shared_ptr<Statement> Parser::parse_macro_def() {
-    std::string varName;
-    std::string macroName;
+Statement Parser::parse_macro_def() {
+    Statement stmt = make_statement(StatementKind::MacroDef);
 
     consume(TokenType::Identifier, "Expected macro variable name");
-    varName = previous().value;
+    stmt.name = intern(previous());
 
     consume(TokenType::Equals, "Expected '='");
     consume(TokenType::Keyword, "Expected 'Macro'");
     if (previous().value != "Macro") throw std::runtime_error("Expected 'Macro(...)'");
     consume(TokenType::LParen, "Expected '('");
     consume(TokenType::String, "Expected macro name string");
-    macroName = previous().value;
+    stmt.text = intern(previous());
     consume(TokenType::RParen, "Expected ')'");
     consume(TokenType::Semicolon, "Expected ';'");
 
-    auto stmt = std::make_shared<MacroDefStatement>();
-    stmt->varName = varName;
-    stmt->macroName = macroName;
     return stmt;
 }
 
 
 // for c++ < 20:
-bool starts_with(const std::string& s, const std::string& prefix) {
+bool starts_with(std::string_view s, std::string_view prefix) {
     return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
 }
 
-std::shared_ptr<Statement> Parser::parse_set_or_read() {
-    std::string varName = advance().value;
+Statement Parser::parse_set_or_read() {
+    std::string_view varName = intern(advance());
 
     consume(TokenType::Dot, "Expected '.'");
     consume(TokenType::Keyword, "Expected setter/reader function");
 
-    std::string func = previous().value;
+    std::string_view func = previous().value;
 
     if (func == "lazy") {
         consume(TokenType::LParen, "Expected '(' after lazy");
         consume(TokenType::RParen, "Expected ')' after lazy()");
         consume(TokenType::Semicolon, "Expected ';' after lazy()");
-        auto stmt = std::make_shared<LazyStatement>();
-        stmt->varName = varName;
+        Statement stmt = make_statement(StatementKind::Lazy);
+        stmt.name = varName;
         return stmt;
     }
 
@@ -110,108 +136,97 @@ std::shared_ptr<Statement> Parser::parse_set_or_read() {
 
     consume(TokenType::LParen, "Expected '('");
 
-    std::vector<std::string> parts;
-    std::vector<bool> isLiteral;
-
+    IndexRange parts;
+    parts.begin = static_cast<uint32_t>(partList.size());
     do {
         if (match(TokenType::String)) {
-            parts.push_back(previous().value);
-            isLiteral.push_back(true);
+            partList.push_back(ValuePart{intern(previous()), true});
         } else if (match(TokenType::Identifier)) {
-            parts.push_back(previous().value);
-            isLiteral.push_back(false);
+            partList.push_back(ValuePart{intern(previous()), false});
         } else {
-            throw std::runtime_error("Expected string literal or string variable inside " + func);
+            throw std::runtime_error("Expected string literal or string variable inside " + std::string(func));
         }
     } while (match(TokenType::Plus));
+    parts.end = static_cast<uint32_t>(partList.size());
 
     consume(TokenType::RParen, "Expected ')'");
     consume(TokenType::Semicolon, "Expected ';'");
 
-    if (isDefault) {
-        auto stmt = std::make_shared<SetDefaultStatement>();
-        stmt->varName = varName;
-        stmt->parts = parts;
-        stmt->isLiteral = isLiteral;
-        stmt->isReadFromFile = isRead;
-        return stmt;
-    } else {
-        auto stmt = std::make_shared<SetStatement>();
-        stmt->varName = varName;
-        stmt->isReadFromFile = isRead;
-        stmt->parts = parts;
-        stmt->isLiteral = isLiteral;
+    Statement stmt = make_statement(isDefault ? StatementKind::SetDefault : StatementKind::Set);
+    stmt.name = varName;
+    stmt.range = parts;
+    stmt.flag = isRead;
 
+    if (!isDefault) {
         size_t underscore = func.find('_');
         if (underscore != std::string::npos) {
-            stmt->backend = func.substr(underscore + 1);
+            stmt.text = program.arena.copy(func.substr(underscore + 1));
         } else {
             throw std::runtime_error("Invalid set/read function name");
         }
-
-        return stmt;
     }
+
+    return stmt;
 }
 
 
-std::shared_ptr<Statement> Parser::parse_lazy() {
+Statement Parser::parse_lazy() {
     throw std::runtime_error("lazy() must be used as a method on a macro");
 }
 
-std::shared_ptr<Statement> Parser::parse_boolean() {
+Statement Parser::parse_boolean() {
     consume(TokenType::Identifier, "Expected boolean variable name");
-    std::string name = previous().value;
+    Statement stmt = make_statement(StatementKind::Boolean);
+    stmt.name = intern(previous());
 
     consume(TokenType::Equals, "Expected '='");
     consume(TokenType::Boolean, "Expected TRUE or FALSE");
 
-    bool value = previous().value == "TRUE";
+    stmt.flag = previous().value == "TRUE";
     consume(TokenType::Semicolon, "Expected ';'");
 
-    auto stmt = std::make_shared<BooleanDeclaration>();
-    stmt->name = name;
-    stmt->value = value;
     return stmt;
 }
 
-std::shared_ptr<Statement> Parser::parse_if() {
+Statement Parser::parse_if() {
     consume(TokenType::LParen, "Expected '(' after if");
     consume(TokenType::Identifier, "Expected condition variable");
-    std::string conditionVar = previous().value;
+    Statement stmt = make_statement(StatementKind::If);
+    stmt.name = intern(previous());
     consume(TokenType::RParen, "Expected ')'");
 
     consume(TokenType::LBrace, "Expected '{'");
 
-    std::vector<std::shared_ptr<Statement>> body;
+    std::vector<Statement> body;
     while (!check(TokenType::RBrace) && !check(TokenType::EndOfFile)) {
         body.push_back(parse_statement());
     }
 
     consume(TokenType::RBrace, "Expected '}'");
 
-    auto stmt = std::make_shared<IfStatement>();
-    stmt->conditionVar = conditionVar;
-    stmt->body = body;
+    // Nested blocks were appended while parsing the body; the body itself goes after them.
+    stmt.range = append_block(body);
     return stmt;
 }
 
-std::shared_ptr<Statement> Parser::parse_generate() {
+Statement Parser::parse_generate() {
     consume(TokenType::Arrow, "Expected '->'");
     consume(TokenType::Keyword, "Expected generate function");
 
-    std::string func = previous().value;
+    std::string_view func = previous().value;
     consume(TokenType::LParen, "Expected '('");
 
     if (func == "generate_all") {
         consume(TokenType::RParen, "Expected ')'");
         consume(TokenType::Semicolon, "Expected ';'");
-        return std::make_shared<GenerateAllStatement>();
+        return make_statement(StatementKind::GenerateAll);
     } else if (func == "generate_select") {
-        std::vector<Backend> backends;
+        Statement stmt = make_statement(StatementKind::GenerateSelect);
+        stmt.range.begin = static_cast<uint32_t>(backendList.size());
 
         while (!check(TokenType::RParen)) {
             consume(TokenType::Identifier, "Expected backend name");
-            backends.push_back(parse_backend_enum(previous().value));
+            backendList.push_back(parse_backend_enum(previous().value));
             if (!check(TokenType::RParen)) {
                 consume(TokenType::Comma, "Expected ',' between backends");
             }
@@ -220,32 +235,50 @@ std::shared_ptr<Statement> Parser::parse_generate() {
         consume(TokenType::RParen, "Expected ')'");
         consume(TokenType::Semicolon, "Expected ';'");
 
-        auto stmt = std::make_shared<GenerateSelectStatement>();
-        stmt->backends = backends;
+        stmt.range.end = static_cast<uint32_t>(backendList.size());
         return stmt;
     }
 
-    throw std::runtime_error("Unknown generate function: " + func);
+    throw std::runtime_error("Unknown generate function: " + std::string(func));
 }
 
-std::shared_ptr<Statement> Parser::parse_print() {
+Statement Parser::parse_print() {
     consume(TokenType::Keyword, "Expected SYSTEM");
     if (previous().value != "SYSTEM") throw std::runtime_error("Expected SYSTEM");
 
     consume(TokenType::Arrow, "Expected '->'");
     consume(TokenType::Identifier, "Expected list_backends");
-    std::string expr = previous().value;
+    Statement stmt = make_statement(StatementKind::Print);
+    stmt.text = intern(previous());
 
     consume(TokenType::LParen, "Expected '('");
     consume(TokenType::RParen, "Expected ')'");
     consume(TokenType::Semicolon, "Expected ';'");
 
-    auto stmt = std::make_shared<PrintStatement>();
-    stmt->expression = expr;
     return stmt;
 }
 
-Backend Parser::parse_backend_enum(const std::string& value) {
+const char* backend_name(Backend backend) {
+    switch (backend) {
+        case Backend::GLSL:  return "glsl";
+        case Backend::HLSL:  return "hlsl";
+        case Backend::MSL:   return "msl";
+        case Backend::SPIRV: return "spirv";
+        default:             return "unknown";
+    }
+}
+
+Backend backend_from_name(const std::string& name) {
+    std::string upper;
+    for (char c : name) upper += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    if (upper == "GLSL") return Backend::GLSL;
+    if (upper == "HLSL") return Backend::HLSL;
+    if (upper == "MSL") return Backend::MSL;
+    if (upper == "SPIRV") return Backend::SPIRV;
+    return Backend::UNKNOWN;
+}
+
+Backend Parser::parse_backend_enum(std::string_view value) {
     if (value == "GLSL") return Backend::GLSL;
     if (value == "HLSL") return Backend::HLSL;
     if (value == "MSL") return Backend::MSL;
@@ -253,19 +286,20 @@ Backend Parser::parse_backend_enum(const std::string& value) {
     return Backend::UNKNOWN;
 }
 
-std::shared_ptr<Statement> Parser::parse_string() {
+Statement Parser::parse_string() {
     consume(TokenType::Identifier, "Expected variable name after 'string'");
-    std::string name = previous().value;
+    Statement stmt = make_statement(StatementKind::String);
+    stmt.name = intern(previous());
 
     consume(TokenType::Equals, "Expected '=' after variable name");
 
     std::string result;
     consume(TokenType::String, "Expected string or identifier");
-    result += previous().value;
+    result += token_text(previous());
 
     while (match(TokenType::Plus)) {
         if (match(TokenType::String) || match(TokenType::Identifier)) {
-            result += previous().value;
+            result += token_text(previous());
         } else {
             throw std::runtime_error("Expected string or identifier after '+'");
         }
@@ -273,8 +307,6 @@ std::shared_ptr<Statement> Parser::parse_string() {
 
     consume(TokenType::Semicolon, "Expected ';' after string declaration");
 
-    auto stmt = std::make_shared<StringDeclaration>();
-    stmt->name = name;
-    stmt->expression = result;
+    stmt.text = program.arena.copy(result);
     return stmt;
-}
\ No newline at end of file
+}
@@ -0,0 +1,198 @@
+#include "permutation_sweep.h"
+#include "blob_store.h"
+#include "output_file.h"
+#include "shader_processor.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+bool is_axis(const std::vector<std::string>& axes, std::string_view name) {
+    return std::find(axes.begin(), axes.end(), name) != axes.end();
+}
+
+// True if the statement declares or tests an axis, directly or inside an if body.
+bool touches_axis(const Program& program, const Statement& stmt, const std::vector<std::string>& axes) {
+    if (stmt.kind == StatementKind::Boolean) return is_axis(axes, stmt.name);
+    if (stmt.kind != StatementKind::If) return false;
+    if (is_axis(axes, stmt.name)) return true;
+    for (uint32_t i = stmt.range.begin; i < stmt.range.end; ++i) {
+        if (touches_axis(program, program.statements[i], axes)) return true;
+    }
+    return false;
+}
+
+bool declares_boolean(const Program& program, IndexRange block, std::string_view name) {
+    for (uint32_t i = block.begin; i < block.end; ++i) {
+        const Statement& stmt = program.statements[i];
+        if (stmt.kind == StatementKind::Boolean && stmt.name == name) return true;
+        if (stmt.kind == StatementKind::If && declares_boolean(program, stmt.range, name)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+PermutationSweep::PermutationSweep(std::string_view layoutSource, std::vector<std::string> axes, FileLoader loader,
+                                   bool lazyReads)
+    : axisNames(std::move(axes)) {
+    if (axisNames.size() > MAX_AXES) {
+        throw std::runtime_error("Too many --permute booleans: " + std::to_string(axisNames.size()) +
+                                 " (at most " + std::to_string(MAX_AXES) + ")");
+    }
+
+    std::string source(layoutSource);
+    Tokenizer tokenizer(source);
+    auto tokens = tokenizer.tokenize();
+    Parser parser(tokens);
+    Program program = parser.parse();
+
+    for (size_t i = 0; i < axisNames.size(); ++i) {
+        if (std::find(axisNames.begin(), axisNames.begin() + i, axisNames[i]) != axisNames.begin() + i) {
+            throw std::runtime_error("Boolean listed twice in --permute: " + axisNames[i]);
+        }
+        if (!declares_boolean(program, program.root, axisNames[i])) {
+            throw std::runtime_error("No boolean named " + axisNames[i] + " in layout");
+        }
+    }
+
+    uint32_t first = program.root.begin;
+    while (first < program.root.end && !touches_axis(program, program.statements[first], axisNames)) {
+        ++first;
+    }
+
+    Interpreter prefix;
+    if (loader) {
+        prefix.set_file_loader(std::move(loader));
+    }
+    prefix.set_lazy_reads(lazyReads);
+    prefix.interpret(program, IndexRange{program.root.begin, first});
+
+    std::map<std::string_view, size_t> tables;
+    const size_t combinations = size_t(1) << axisNames.size();
+    for (size_t combination = 0; combination < combinations; ++combination) {
+        Variant variant;
+        Interpreter interpreter = prefix;
+        // Statements after the prefix run once per combination; print their messages once.
+        interpreter.set_quiet(combination > 0);
+        for (size_t a = 0; a < axisNames.size(); ++a) {
+            // The first axis is the most significant bit, so variants are listed FF, FT, TF, TT.
+            bool value = (combination >> (axisNames.size() - 1 - a)) & 1;
+            variant.values.push_back(value);
+            interpreter.override_boolean(axisNames[a], value);
+        }
+        interpreter.interpret(program, IndexRange{first, program.root.end});
+        interpreter.load_reads();
+        variant.table = MacroTable::build(interpreter.get_macros(), interpreter.get_required_backends());
+        variantList.push_back(std::move(variant));
+
+        // Tables share their image, so the view stays valid while variantList holds them.
+        auto [it, inserted] = tables.emplace(variantList.back().table.image(), combination);
+        firstWithTable.push_back(it->second);
+    }
+}
+
+const std::vector<std::string>& PermutationSweep::axes() const {
+    return axisNames;
+}
+
+const std::vector<PermutationSweep::Variant>& PermutationSweep::variants() const {
+    return variantList;
+}
+
+void PermutationSweep::build(const std::vector<ShaderJob>& jobs, unsigned threadCount) const {
+    struct Rendered {
+        std::map<std::string, std::string> outputs; // backend or "macros.json" -> blob path
+        std::vector<std::string> warnings;
+        std::exception_ptr error;
+    };
+
+    std::vector<std::unique_ptr<BlobStore>> stores;
+    std::vector<ShaderTemplate> shaders(jobs.size());
+    std::vector<std::exception_ptr> loadErrors(jobs.size());
+    std::vector<Rendered> rendered(jobs.size() * variantList.size());
+    for (const auto& job : jobs) {
+        stores.push_back(std::make_unique<BlobStore>(job.outputDir + "/blobs"));
+    }
+
+    std::unique_ptr<ThreadPool> pool;
+    if (threadCount > 1) {
+        pool = std::make_unique<ThreadPool>(threadCount);
+    }
+    auto run = [&pool](std::function<void()> task) {
+        if (pool) pool->submit(std::move(task));
+        else task();
+    };
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        run([&, j] {
+            try {
+                shaders[j] = ShaderProcessor::load_shader(jobs[j].shaderPath);
+            } catch (...) {
+                loadErrors[j] = std::current_exception();
+                return;
+            }
+
+            for (size_t v = 0; v < variantList.size(); ++v) {
+                if (firstWithTable[v] != v) continue;
+
+                run([&, j, v] {
+                    Rendered& result = rendered[j * variantList.size() + v];
+                    const MacroTable& table = variantList[v].table;
+                    try {
+                        for (Backend backend : table.required_backends()) {
+                            std::string output = shaders[j].render(table, backend, &result.warnings);
+                            result.outputs[backend_name(backend)] =
+                                "blobs/" + stores[j]->put(output, std::string(".") + backend_name(backend));
+                        }
+                        result.outputs["macros.json"] = "blobs/" + stores[j]->put(table.metadata_json(), ".json");
+                    } catch (...) {
+                        result.error = std::current_exception();
+                    }
+                });
+            }
+        });
+    }
+
+    if (pool) pool->wait();
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        if (loadErrors[j]) std::rethrow_exception(loadErrors[j]);
+
+        json manifest;
+        manifest["axes"] = axisNames;
+        manifest["variants"] = json::array();
+        std::set<std::string> reported;
+        for (size_t v = 0; v < variantList.size(); ++v) {
+            const Rendered& result = rendered[j * variantList.size() + firstWithTable[v]];
+            for (const auto& warning : result.warnings) {
+                if (reported.insert(warning).second) std::cerr << warning << "\n";
+            }
+            if (result.error) std::rethrow_exception(result.error);
+
+            json variant;
+            for (size_t a = 0; a < axisNames.size(); ++a) {
+                variant["booleans"][axisNames[a]] = static_cast<bool>(variantList[v].values[a]);
+            }
+            variant["outputs"] = result.outputs;
+            manifest["variants"].push_back(variant);
+        }
+
+        std::string manifestPath = jobs[j].outputDir + "/permutations.json";
+        if (write_if_changed(manifestPath, manifest.dump(4)) == WriteStatus::Failed) {
+            throw std::runtime_error("Failed to write to output: " + manifestPath);
+        }
+        std::cout << "Generated: " << manifestPath << " (" << variantList.size() << " variants, "
+                  << stores[j]->size() << " distinct files)\n";
+    }
+}
@@ -1,13 +1,46 @@
 #include "shader_processor.h"
+#include "macro_scanner.h"
+#include "output_file.h"
+#include <algorithm>
 #include <fstream>
+#include <istream>
+#include <ostream>
 #include <sstream>
-#include <iostream>
-#include <regex>
+
+static void write_output(const std::string& outputPath, const std::string& output) {
+    if (write_if_changed(outputPath, output) == WriteStatus::Failed) {
+        throw std::runtime_error("Failed to write to output: " + outputPath);
+    }
+}
 
 void ShaderProcessor::process_shader(const std::string& inputShaderPath,
                                      const std::string& outputPath,
                                      const std::map<std::string, Macro>& macros,
-                                     const std::string& backendName) {
+                                     Backend backend) {
+    process_shader(load_shader(inputShaderPath), outputPath, macros, backend);
+}
+
+void ShaderProcessor::process_shader(const ShaderTemplate& shader,
+                                     const std::string& outputPath,
+                                     const std::map<std::string, Macro>& macros,
+                                     Backend backend,
+                                     std::vector<std::string>* warnings) {
+    write_output(outputPath, shader.render(macros, backend, warnings));
+}
+
+void ShaderProcessor::process_shader(const ShaderTemplate& shader,
+                                     const std::string& outputPath,
+                                     const MacroTable& table,
+                                     Backend backend,
+                                     std::vector<std::string>* warnings) {
+    write_output(outputPath, shader.render(table, backend, warnings));
+}
+
+ShaderTemplate ShaderProcessor::load_shader(const std::string& inputShaderPath) {
+    return ShaderTemplate::compile(read_shader(inputShaderPath));
+}
+
+std::string ShaderProcessor::read_shader(const std::string& inputShaderPath) {
     std::ifstream infile(inputShaderPath);
     if (!infile.is_open()) {
         throw std::runtime_error("Failed to open shader file: " + inputShaderPath);
@@ -15,48 +48,106 @@ void ShaderProcessor::process_shader(const std::string& inputShaderPath,
 
     std::stringstream buffer;
     buffer << infile.rdbuf();
-    std::string shaderCode = buffer.str();
+    return buffer.str();
+}
+
+std::string ShaderProcessor::expand_shader(std::string_view shaderCode,
+                                           const std::map<std::string, Macro>& macros,
+                                           Backend backend) {
+    return ShaderTemplate::compile(std::string(shaderCode)).render(macros, backend);
+}
 
-    // Regex to find %MACRONAME
-    std::regex macroRegex(R"(%([A-Za-z_][A-Za-z0-9_]*))");
-    std::smatch match;
+void ShaderProcessor::stream_shader(std::istream& in, std::ostream& out,
+                                    const MacroTable& table, Backend backend,
+                                    std::vector<std::string>* warnings,
+                                    size_t chunkSize) {
+    // Longer names cannot be in the table, so at most this much is carried over.
+    size_t longestName = 0;
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        longestName = std::max(longestName, table.name(i).size());
+    }
 
-    std::string output;
-    std::string::const_iterator searchStart(shaderCode.cbegin());
+    std::string buffer;
+    std::string skippedName; // an over-long name still being dropped, for its warning
+    bool skipping = false;
+    bool eof = false;
 
-    while (std::regex_search(searchStart, shaderCode.cend(), match, macroRegex)) {
-        std::string beforeMatch = match.prefix().str();
-        std::string macroName = match[1].str();
+    while (!eof) {
+        // Append the next chunk behind whatever the previous round carried over.
+        size_t carried = buffer.size();
+        buffer.resize(carried + chunkSize);
+        in.read(&buffer[carried], static_cast<std::streamsize>(chunkSize));
+        buffer.resize(carried + static_cast<size_t>(in.gcount()));
+        eof = !in;
+        if (in.bad()) {
+            throw std::runtime_error("Failed to read shader input");
+        }
 
-        output += beforeMatch;
+        const char* const begin = buffer.data();
+        const char* const end = begin + buffer.size();
+        const char* p = begin;
+        const char* consumed = end;
 
-        if (macros.count(macroName)) {
-            const Macro& macro = macros.at(macroName);
-            std::string lowerBackend = backendName;
-            std::transform(lowerBackend.begin(), lowerBackend.end(), lowerBackend.begin(), ::tolower);
+        if (skipping) {
+            while (p != end && is_macro_name_char(*p)) {
+                ++p;
+            }
+            skippedName.append(begin, p);
+            if (p == end && !eof) {
+                buffer.clear();
+                continue;
+            }
+            report_unresolved_macro(skippedName, false, backend, warnings);
+            skipping = false;
+        }
+        const char* literalStart = p;
 
-            if (macro.backendValues.count(lowerBackend)) {
-                output += macro.backendValues.at(lowerBackend);
-            } else if (!macro.defaultValue.empty()) {
-                output += macro.defaultValue;
-            } else if (macro.lazy) {
-                output += macro.macroName;
+        while ((p = find_macro_marker(p, end)) != end) {
+            const char* nameStart = p + 1;
+            if (nameStart != end && !is_macro_name_start(*nameStart)) {
+                ++p;
+                continue;
+            }
+            const char* nameEnd = nameStart;
+            while (nameEnd != end && is_macro_name_char(*nameEnd)) {
+                ++nameEnd;
+            }
+            if (nameEnd == end && !eof) {
+                // The name may continue in the next chunk; keep it for the next round.
+                if (static_cast<size_t>(nameEnd - nameStart) <= longestName) {
+                    consumed = p;
+                    break;
+                }
+                // No macro is this long. Drop it like any undefined macro as it streams
+                // past; only its name is kept, so the warning matches a whole-file run.
+                out.write(literalStart, p - literalStart);
+                skippedName.assign(nameStart, nameEnd);
+                skipping = true;
+                literalStart = end;
+                break;
+            }
+            if (nameStart == nameEnd) {
+                ++p;
+                continue;
+            }
+
+            out.write(literalStart, p - literalStart);
+            std::string_view name(nameStart, static_cast<size_t>(nameEnd - nameStart));
+            std::string_view value;
+            uint32_t index = table.find(name);
+            if (index != MacroTable::NOT_FOUND && table.value(index, backend, value)) {
+                out.write(value.data(), static_cast<std::streamsize>(value.size()));
             } else {
-                std::cerr << "Warning: No definition found for macro %" << macroName
-                          << " for backend " << backendName << "\n";
+                report_unresolved_macro(name, index != MacroTable::NOT_FOUND, backend, warnings);
             }
-        } else {
-            std::cerr << "Warning: Undefined macro %" << macroName << " found in shader\n";
+            literalStart = p = nameEnd;
         }
 
-        searchStart = match.suffix().first;
+        out.write(literalStart, consumed - literalStart);
+        buffer.erase(0, static_cast<size_t>(consumed - begin));
     }
 
-    output += std::string(searchStart, shaderCode.cend());
-
-    std::ofstream outfile(outputPath);
-    if (!outfile.is_open()) {
-        throw std::runtime_error("Failed to write to output: " + outputPath);
+    if (!out) {
+        throw std::runtime_error("Failed to write shader output");
     }
-    outfile << output;
 }
@@ -0,0 +1,224 @@
+#include "shader_template.h"
+#include "macro_scanner.h"
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+// Serialized layout, integers little-endian:
+//   char[8] "SLSHADER", u32 version, u32 literal count, u32 slot count, u32 name count,
+//   u64 text size, text, literal count * (u64 offset, u64 length), slot count * u32,
+//   name count * (u32 length, bytes).
+constexpr char MAGIC[8] = {'S', 'L', 'S', 'H', 'A', 'D', 'E', 'R'};
+constexpr uint32_t FORMAT_VERSION = 1;
+
+void append_int(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out += static_cast<char>(value >> (8 * i));
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data(data) {}
+
+    bool read_int(uint64_t& value, int bytes) {
+        if (data.size() - pos < static_cast<size_t>(bytes)) return false;
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += bytes;
+        return true;
+    }
+
+    bool read_bytes(std::string_view& bytes, uint64_t size) {
+        if (data.size() - pos < size) return false;
+        bytes = data.substr(pos, size);
+        pos += size;
+        return true;
+    }
+
+    bool at_end() const { return pos == data.size(); }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+};
+
+} // namespace
+
+void report_unresolved_macro(std::string_view name, bool defined, Backend backend,
+                             std::vector<std::string>* warnings) {
+    std::string warning = !defined
+        ? "Warning: Undefined macro %" + std::string(name) + " found in shader"
+        : "Warning: No definition found for macro %" + std::string(name) + " for backend " + backend_name(backend);
+    if (warnings) {
+        warnings->push_back(std::move(warning));
+    } else {
+        std::cerr << warning << "\n";
+    }
+}
+
+ShaderTemplate ShaderTemplate::compile(std::string source) {
+    ShaderTemplate shader;
+    shader.text = std::move(source);
+
+    std::unordered_map<std::string_view, uint32_t> ids;
+    const char* base = shader.text.data();
+
+    scan_macros(shader.text,
+        [&](std::string_view literal) {
+            shader.literals.push_back(Span{static_cast<size_t>(literal.data() - base), literal.size()});
+        },
+        [&](std::string_view name) {
+            auto [it, inserted] = ids.emplace(name, static_cast<uint32_t>(shader.names.size()));
+            if (inserted) {
+                shader.names.emplace_back(name);
+            }
+            shader.slots.push_back(it->second);
+        });
+
+    return shader;
+}
+
+std::string ShaderTemplate::render(const std::map<std::string, Macro>& macros, Backend backend,
+                                   std::vector<std::string>* warnings, size_t* substitutions) const {
+    // Resolve every distinct macro once.
+    std::vector<Resolved> resolved(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        auto it = macros.find(names[i]);
+        if (it == macros.end()) continue;
+        resolved[i].defined = true;
+
+        resolved[i].hasValue = it->second.resolve(backend, resolved[i].value);
+    }
+
+    return emit(resolved, backend, warnings, substitutions);
+}
+
+std::string ShaderTemplate::render(const MacroTable& table, Backend backend,
+                                   std::vector<std::string>* warnings, size_t* substitutions) const {
+    std::vector<Resolved> resolved(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        uint32_t index = table.find(names[i]);
+        if (index == MacroTable::NOT_FOUND) continue;
+        resolved[i].defined = true;
+        resolved[i].hasValue = table.value(index, backend, resolved[i].value);
+    }
+
+    return emit(resolved, backend, warnings, substitutions);
+}
+
+std::string ShaderTemplate::emit(const std::vector<Resolved>& resolved, Backend backend,
+                                 std::vector<std::string>* warnings, size_t* substitutions) const {
+    size_t outputSize = text.size();
+    for (uint32_t slot : slots) {
+        outputSize += resolved[slot].value.size();
+    }
+
+    std::string output;
+    output.reserve(outputSize);
+    output.append(text, literals[0].offset, literals[0].length);
+
+    size_t resolvedCount = 0;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        const Resolved& macro = resolved[slots[i]];
+        if (macro.hasValue) {
+            output += macro.value;
+            ++resolvedCount;
+        } else {
+            report_unresolved_macro(names[slots[i]], macro.defined, backend, warnings);
+        }
+
+        const Span& literal = literals[i + 1];
+        output.append(text, literal.offset, literal.length);
+    }
+
+    if (substitutions) *substitutions = resolvedCount;
+    return output;
+}
+
+std::string ShaderTemplate::serialize() const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    append_int(out, FORMAT_VERSION, 4);
+    append_int(out, literals.size(), 4);
+    append_int(out, slots.size(), 4);
+    append_int(out, names.size(), 4);
+    append_int(out, text.size(), 8);
+    out += text;
+    for (const Span& literal : literals) {
+        append_int(out, literal.offset, 8);
+        append_int(out, literal.length, 8);
+    }
+    for (uint32_t slot : slots) {
+        append_int(out, slot, 4);
+    }
+    for (const auto& name : names) {
+        append_int(out, name.size(), 4);
+        out += name;
+    }
+    return out;
+}
+
+bool ShaderTemplate::deserialize(std::string_view data, ShaderTemplate& shader) {
+    if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) return false;
+    Reader reader(data.substr(sizeof(MAGIC)));
+
+    uint64_t version, literalCount, slotCount, nameCount, textSize;
+    std::string_view bytes;
+    if (!reader.read_int(version, 4) || version != FORMAT_VERSION ||
+        !reader.read_int(literalCount, 4) || !reader.read_int(slotCount, 4) ||
+        !reader.read_int(nameCount, 4) || literalCount != slotCount + 1 ||
+        !reader.read_int(textSize, 8) || !reader.read_bytes(bytes, textSize)) {
+        return false;
+    }
+
+    ShaderTemplate result;
+    result.text.assign(bytes.data(), bytes.size());
+    for (uint64_t i = 0; i < literalCount; ++i) {
+        uint64_t offset, length;
+        if (!reader.read_int(offset, 8) || !reader.read_int(length, 8) ||
+            offset > textSize || length > textSize - offset) {
+            return false;
+        }
+        result.literals.push_back(Span{static_cast<size_t>(offset), static_cast<size_t>(length)});
+    }
+    for (uint64_t i = 0; i < slotCount; ++i) {
+        uint64_t slot;
+        if (!reader.read_int(slot, 4) || slot >= nameCount) return false;
+        result.slots.push_back(static_cast<uint32_t>(slot));
+    }
+    for (uint64_t i = 0; i < nameCount; ++i) {
+        uint64_t length;
+        if (!reader.read_int(length, 4) || !reader.read_bytes(bytes, length)) return false;
+        result.names.emplace_back(bytes);
+    }
+    if (!reader.at_end()) return false;
+
+    shader = std::move(result);
+    return true;
+}
+
+const std::string& ShaderTemplate::source() const {
+    return text;
+}
+
+const std::vector<std::string>& ShaderTemplate::macro_names() const {
+    return names;
+}
+
+size_t ShaderTemplate::slot_count() const {
+    return slots.size();
+}
+
+std::vector<MacroUsage> ShaderTemplate::usage() const {
+    std::vector<MacroUsage> result(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        result[i].name = names[i];
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        // Slot i sits between literal i and literal i + 1, starting at its '%'.
+        result[slots[i]].offsets.push_back(literals[i].offset + literals[i].length);
+    }
+    return result;
+}
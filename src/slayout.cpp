@@ -0,0 +1,97 @@
+#include "slayout.h"
+#include "tokenizer.h"
+
+Layout Layout::compile(std::string_view source, FileLoader loader, BuildStats* stats, bool lazyReads) {
+    Layout layout;
+    layout.layoutSource.assign(source.data(), source.size());
+
+    std::vector<Token> tokens;
+    {
+        BuildStats::Span span(stats, "tokenize");
+        Tokenizer tokenizer(layout.layoutSource);
+        tokens = tokenizer.tokenize();
+    }
+
+    Program program;
+    {
+        BuildStats::Span span(stats, "parse");
+        Parser parser(tokens);
+        program = parser.parse();
+    }
+
+    Interpreter interpreter;
+    if (loader) {
+        interpreter.set_file_loader(std::move(loader));
+    }
+    {
+        BuildStats::Span span(stats, "interpret");
+        interpreter.set_stats(stats);
+        interpreter.set_lazy_reads(lazyReads);
+        interpreter.interpret(program);
+    }
+
+    layout.loadedFiles = interpreter.get_loaded_files();
+    {
+        BuildStats::Span span(stats, "build_table");
+        layout.macroTable = MacroTable::build(interpreter.get_macros(), interpreter.get_required_backends());
+    }
+
+    if (stats) {
+        stats->add("layout_bytes_read", layout.layoutSource.size());
+        stats->add("tokens", tokens.size());
+        stats->add("statements", program.statements.size());
+        stats->add("macros", interpreter.get_macros().size());
+        for (const auto& file : layout.loadedFiles) {
+            stats->add("include_files_loaded");
+            stats->add("include_bytes_read", file.size);
+        }
+    }
+    return layout;
+}
+
+Layout Layout::open_table(const std::string& path) {
+    Layout layout;
+    layout.macroTable = MacroTable::open(path);
+    return layout;
+}
+
+void Layout::write_table(const std::string& path) const {
+    macroTable.write(path);
+}
+
+std::string Layout::expand(std::string_view shaderSource, Backend backend,
+                           std::vector<std::string>* warnings) const {
+    return expand(ShaderTemplate::compile(std::string(shaderSource)), backend, warnings);
+}
+
+std::string Layout::expand(const ShaderTemplate& shader, Backend backend,
+                           std::vector<std::string>* warnings) const {
+    return shader.render(macroTable, backend, warnings);
+}
+
+std::map<Backend, std::string> Layout::expand_all(std::string_view shaderSource,
+                                                  std::vector<std::string>* warnings) const {
+    ShaderTemplate shader = ShaderTemplate::compile(std::string(shaderSource));
+
+    std::map<Backend, std::string> outputs;
+    for (Backend backend : backends()) {
+        outputs[backend] = expand(shader, backend, warnings);
+    }
+    return outputs;
+}
+
+std::vector<Backend> Layout::backends() const {
+    return macroTable.required_backends();
+}
+
+const std::string& Layout::source() const {
+    return layoutSource;
+}
+
+const std::vector<LoadedFile>& Layout::loaded_files() const {
+    return loadedFiles;
+}
+
+const MacroTable& Layout::table() const {
+    return macroTable;
+}
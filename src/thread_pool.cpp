@@ -0,0 +1,125 @@
+#include "thread_pool.h"
+
+namespace {
+// Identifies the pool and queue the current thread works on, so nested submits stay local.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local unsigned currentQueue = 0;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned index = currentPool == this
+        ? currentQueue
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<unsigned>(queues.size());
+
+    unfinished.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    // Pairs with the sleeper count in worker_loop: either this sees the worker
+    // asleep and wakes it, or the worker sees the task and does not sleep.
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) > 0) {
+        // Taking the mutex orders this after a sleeper's predicate check.
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        workAvailable.notify_one();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this] { return unfinished.load(std::memory_order_acquire) == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(workers.size());
+}
+
+unsigned ThreadPool::default_thread_count() {
+    unsigned count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+bool ThreadPool::try_pop(unsigned index, std::function<void()>& task) {
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(unsigned index) {
+    currentPool = this;
+    currentQueue = index;
+
+    while (true) {
+        std::function<void()> task;
+        if (!try_pop(index, task)) {
+            if (queued.load(std::memory_order_seq_cst) > 0) {
+                // Pushed but not counted as popped yet; the window is a few instructions.
+                std::this_thread::yield();
+                continue;
+            }
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            workAvailable.wait(lock, [this] { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (stopping && queued.load(std::memory_order_seq_cst) <= 0) return;
+            continue;
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+
+        if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            allDone.notify_all();
+        }
+    }
+}
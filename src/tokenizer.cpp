@@ -1,7 +1,89 @@
 #include "tokenizer.h"
+#include <array>
 #include <cctype>
+#include <cstdint>
+
+namespace {
+
+struct KeywordEntry {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr KeywordEntry KEYWORDS[] = {
+    {"string", TokenType::Keyword}, {"macrodef", TokenType::Keyword}, {"Macro", TokenType::Keyword},
+    {"lazy", TokenType::Keyword}, {"boolean", TokenType::Keyword},
+    {"if", TokenType::Keyword}, {"print", TokenType::Keyword},
+    {"set_glsl", TokenType::Keyword}, {"set_hlsl", TokenType::Keyword},
+    {"set_msl", TokenType::Keyword}, {"set_spirv", TokenType::Keyword},
+    {"read_glsl", TokenType::Keyword}, {"read_hlsl", TokenType::Keyword},
+    {"read_msl", TokenType::Keyword}, {"read_spirv", TokenType::Keyword},
+    {"set_default", TokenType::Keyword}, {"read_default", TokenType::Keyword},
+    {"generate_all", TokenType::Keyword}, {"generate_select", TokenType::Keyword},
+    {"SYSTEM", TokenType::Keyword},
+    {"TRUE", TokenType::Boolean}, {"FALSE", TokenType::Boolean},
+};
+constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+// Perfect hash over the keyword set: first char, fourth-from-last char, last char
+// and length packed into a word, then multiplied and shifted into a 32-slot table.
+// The multiplier was searched for offline; the static_assert below rejects any
+// keyword list it does not separate.
+constexpr unsigned KEYWORD_TABLE_BITS = 5;
+constexpr uint32_t KEYWORD_HASH_MULTIPLIER = 0x43171eefu;
+
+constexpr uint32_t keyword_hash(std::string_view s) {
+    size_t n = s.size();
+    uint32_t key = static_cast<uint32_t>(static_cast<unsigned char>(s[0])) |
+                   static_cast<uint32_t>(static_cast<unsigned char>(s[n >= 4 ? n - 4 : 0])) << 8 |
+                   static_cast<uint32_t>(static_cast<unsigned char>(s[n - 1])) << 16 |
+                   static_cast<uint32_t>(n) << 24;
+    return static_cast<uint32_t>(key * KEYWORD_HASH_MULTIPLIER) >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr std::array<int8_t, 1u << KEYWORD_TABLE_BITS> build_keyword_table() {
+    std::array<int8_t, 1u << KEYWORD_TABLE_BITS> table{};
+    for (auto& slot : table) slot = -1;
+    for (size_t i = 0; i < KEYWORD_COUNT; ++i) {
+        uint32_t h = keyword_hash(KEYWORDS[i].text);
+        if (table[h] != -1) return {};  // collision: all zeros, caught below
+        table[h] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+constexpr auto KEYWORD_TABLE = build_keyword_table();
+
+constexpr bool keyword_table_is_perfect() {
+    for (size_t i = 0; i < KEYWORD_COUNT; ++i) {
+        if (KEYWORD_TABLE[keyword_hash(KEYWORDS[i].text)] != static_cast<int8_t>(i)) return false;
+    }
+    return true;
+}
+static_assert(keyword_table_is_perfect(), "keyword hash has collisions; pick a new KEYWORD_HASH_MULTIPLIER");
+
+// Returns the keyword's token type, or Identifier for anything else.
+TokenType classify_word(std::string_view word) {
+    int8_t index = KEYWORD_TABLE[keyword_hash(word)];
+    if (index >= 0 && KEYWORDS[index].text == word) return KEYWORDS[index].type;
+    return TokenType::Identifier;
+}
+
+} // namespace
 
-Tokenizer::Tokenizer(const std::string& src)
+std::string token_text(const Token& token) {
+    if (!token.hasEscapes) return std::string(token.value);
+
+    std::string text;
+    text.reserve(token.value.size());
+    for (size_t i = 0; i < token.value.size(); ++i) {
+        if (token.value[i] == '\\' && i + 1 < token.value.size()) ++i;
+        text += token.value[i];
+    }
+    return text;
+}
+
+Tokenizer::Tokenizer(std::string_view src)
     : source(src), pos(0), line(1), column(1) {}
 
 char Tokenizer::peek() const {
@@ -43,50 +125,37 @@ void Tokenizer::skip_whitespace_and_comments() {
     }
 }
 
-Token Tokenizer::make_token(TokenType type, const std::string& value) {
-    return Token{ type, value, line, column };
+Token Tokenizer::make_token(TokenType type, std::string_view value, bool hasEscapes) {
+    return Token{ type, value, line, column, hasEscapes };
 }
 
 Token Tokenizer::string() {
     advance(); // Skip opening quote
-    std::string value;
+    size_t start = pos;
+    bool hasEscapes = false;
     while (peek() != '"' && peek() != '\0') {
-        if (peek() == '\\') { // Escape handling
-            advance(); // skip '\'
-            value += advance();
-        } else {
-            value += advance();
+        if (peek() == '\\') { // Escapes are resolved later by token_text()
+            advance();
+            hasEscapes = true;
         }
+        advance();
     }
+    std::string_view value = source.substr(start, pos - start);
 
     if (peek() == '"') advance();
     else throw std::runtime_error("Unterminated string");
 
-    return make_token(TokenType::String, value);
+    return make_token(TokenType::String, value, hasEscapes);
 }
 
 Token Tokenizer::identifier_or_keyword() {
-    std::string value;
+    size_t start = pos;
     while (is_alphanumeric(peek()) || peek() == '_') {
-        value += advance();
-    }
-
-    if (value == "string" || value == "macrodef" || value == "Macro" ||
-        value == "lazy" || value == "boolean" ||
-        value == "if" || value == "print" ||
-        value == "set_glsl" || value == "set_hlsl" ||
-        value == "set_msl" || value == "set_spirv" ||
-        value == "read_glsl" || value == "read_hlsl" ||
-        value == "read_msl" || value == "read_spirv" ||
-        value == "set_default" || value == "read_default" ||
-        value == "generate_all" || value == "generate_select" ||
-        value == "SYSTEM") {
-        return make_token(TokenType::Keyword, value);
-    } else if (value == "TRUE" || value == "FALSE") {
-        return make_token(TokenType::Boolean, value);
+        advance();
     }
 
-    return make_token(TokenType::Identifier, value);
+    std::string_view value = source.substr(start, pos - start);
+    return make_token(classify_word(value), value);
 }
 
 Token Tokenizer::symbol() {
@@ -112,6 +181,7 @@ Token Tokenizer::symbol() {
 
 std::vector<Token> Tokenizer::tokenize() {
     std::vector<Token> tokens;
+    tokens.reserve(source.size() / 4 + 1);
 
     while (pos < source.size()) {
         skip_whitespace_and_comments();